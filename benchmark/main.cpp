@@ -0,0 +1,382 @@
+// CPU microbenchmarks of the volume kernels the GPU integrator spends its time in:
+// NanovdbVolume::sample, sampler::sample_distance, the transmittance estimators of
+// sampler.slang, HGPhaseFunction::sample_p and a scatter-NEE-phase random walk
+// combining them. The estimators are also compared in variance per shadow ray.
+//
+//   peacock_bench --volume smoke.vdb [--precision fp8] [--rays 8192] [--repeat 5]
+//
+// Every kernel runs single-threaded over the same pre-generated workload and the best
+// of --repeat runs is reported, so numbers are comparable across commits on one host.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nvutils/file_operations.hpp>
+#include <nvutils/parameter_parser.hpp>
+#include <nvutils/parameter_registry.hpp>
+
+#include "peacock/scene/host_volume.h"
+#include "peacock/scene/majorant_grid.h"
+#include "peacock/scene/volume.h"
+#include "perf_counters.h"
+#include "volume_kernels.h"
+
+using namespace peacock;
+using namespace peacock::bench;
+
+namespace {
+
+struct BenchSettings {
+  std::filesystem::path volumePath;
+  std::string precision{"float"};
+  float tolerance{0.001f};
+  bool volumeCache{true};
+  uint32_t majorantCellSize{16};
+  float densityScale{0.0f};  // 0 = keep the volume's default
+  uint32_t rays{4096};
+  uint32_t lookups{1u << 20};
+  uint32_t maxDepth{8};
+  uint32_t repeat{3};
+  uint32_t seed{1};
+  uint32_t estimates{16};  // transmittance estimates per ray for the variance table
+};
+
+struct KernelResult {
+  const char* name;
+  uint64_t ops{0};
+  double seconds{0.0};
+  KernelCounters counters;
+  PerfCounters::Values perf;
+};
+
+// Keeps the optimizer from discarding kernel results.
+volatile float g_sink = 0.0f;
+
+// Runs `fn` (which performs `ops` operations) `repeat` times and keeps the
+// fastest run together with its counters.
+KernelResult runKernel(const char* name, uint64_t ops, uint32_t repeat, VolumeKernels& kernels,
+                       PerfCounters& perf, const std::function<float()>& fn) {
+  KernelResult best{name, ops};
+  best.seconds = std::numeric_limits<double>::max();
+  for (uint32_t run = 0; run < std::max(repeat, 1u); ++run) {
+    kernels.counters = {};
+    perf.start();
+    const auto start = std::chrono::steady_clock::now();
+    g_sink = g_sink + fn();
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const PerfCounters::Values values = perf.stop();
+    if (seconds < best.seconds) {
+      best.seconds = seconds;
+      best.counters = kernels.counters;
+      best.perf = values;
+    }
+  }
+  return best;
+}
+
+// Rays from a sphere around the volume towards uniformly distributed points inside
+// its bounds, clipped to the bounds; rays that miss are dropped.
+struct BoundedRay {
+  Ray ray;
+  float tMin;
+  float tMax;
+};
+
+std::vector<BoundedRay> makeRays(const shaderio::VolumeDesc& desc, uint32_t count,
+                                 uint32_t seed) {
+  const glm::vec3 center = 0.5f * (desc.bboxMin + desc.bboxMax);
+  const float radius = glm::length(desc.bboxMax - desc.bboxMin);
+  RandomSampler rng{seed * 9781u + 1u};
+
+  std::vector<BoundedRay> rays;
+  rays.reserve(count);
+  while (rays.size() < count) {
+    const float z = 1.0f - 2.0f * rng.nextFloat();
+    const float phi = 6.28318530717958647692f * rng.nextFloat();
+    const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    const glm::vec3 origin = center + radius * glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+    const glm::vec3 target =
+        glm::mix(desc.bboxMin, desc.bboxMax,
+                 glm::vec3(rng.nextFloat(), rng.nextFloat(), rng.nextFloat()));
+    const Ray ray{origin, glm::normalize(target - origin)};
+    if (const auto hit = intersectBox(ray, desc.bboxMin, desc.bboxMax)) {
+      rays.push_back({ray, std::max(hit->x, 0.0f), hit->y});
+    }
+  }
+  return rays;
+}
+
+// Lookup positions marched along the rays (coherent, as in a tracker) and the same
+// positions shuffled (incoherent, defeats the accessor and hardware caches).
+std::vector<glm::vec3> makeLookups(const std::vector<BoundedRay>& rays, uint32_t count) {
+  std::vector<glm::vec3> positions;
+  positions.reserve(count);
+  constexpr uint32_t kStepsPerRay = 256;
+  for (size_t i = 0; positions.size() < count; i = (i + 1) % rays.size()) {
+    const BoundedRay& r = rays[i];
+    const float dt = (r.tMax - r.tMin) / kStepsPerRay;
+    for (uint32_t s = 0; s < kStepsPerRay && positions.size() < count; ++s) {
+      positions.push_back(r.ray.o + (r.tMin + (s + 0.5f) * dt) * r.ray.d);
+    }
+  }
+  return positions;
+}
+
+void printResult(const KernelResult& r, bool perfAvailable) {
+  const KernelCounters& c = r.counters;
+  const double ops = static_cast<double>(std::max<uint64_t>(r.ops, 1));
+  const double lookups = static_cast<double>(std::max<uint64_t>(c.densityLookups, 1));
+  const double reads = static_cast<double>(std::max<uint64_t>(c.voxelReads, 1));
+  const double nsPerOp = r.seconds * 1e9 / ops;
+
+  printf("%-22s %9llu %10.1f %11.2f", r.name, static_cast<unsigned long long>(r.ops), nsPerOp,
+         c.densityLookups / ops);
+  if (c.densityLookups > 0) {
+    printf(" %9.1f", r.seconds * 1e9 / lookups);
+  } else {
+    printf(" %9s", "-");
+  }
+  if (c.collisions > 0) {
+    printf(" %6.1f%%", 100.0 * c.nullCollisions / c.collisions);
+  } else {
+    printf(" %7s", "-");
+  }
+  if (c.voxelReads > 0) {
+    printf("  %5.1f/%5.1f/%5.1f/%5.1f", 100.0 * c.accessorLevel[0] / reads,
+           100.0 * c.accessorLevel[1] / reads, 100.0 * c.accessorLevel[2] / reads,
+           100.0 * c.accessorLevel[3] / reads);
+  } else {
+    printf("  %23s", "-");
+  }
+  if (perfAvailable && c.densityLookups > 0) {
+    printf(" %9.2f %9.3f", r.perf.l1dReadMisses / lookups, r.perf.llcMisses / lookups);
+  } else if (perfAvailable) {
+    printf(" %9.2f %9.3f", r.perf.l1dReadMisses / ops, r.perf.llcMisses / ops);
+  } else {
+    printf(" %9s %9s", "n/a", "n/a");
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchSettings settings;
+
+  nvutils::ParameterRegistry parameterRegistry;
+  nvutils::ParameterParser parameterParser(nvutils::getExecutablePath().stem().string());
+  parameterRegistry.add({"volume", "VDB asset to benchmark"}, &settings.volumePath);
+  parameterRegistry.add({"precision", "Density grid type: float, fp16, fp8, fp4 or fpn"},
+                        &settings.precision);
+  parameterRegistry.add({"tolerance", "Absolute error bound of --precision fpn"},
+                        &settings.tolerance);
+  parameterRegistry.add({"volume-cache", "Use the .nvdb sidecar cache next to the volume"},
+                        &settings.volumeCache);
+  parameterRegistry.add({"majorant-cell", "Majorant grid cell size in voxels"},
+                        &settings.majorantCellSize);
+  parameterRegistry.add({"density-scale", "Override the volume's density scale (0 = keep)"},
+                        &settings.densityScale);
+  parameterRegistry.add({"rays", "Rays (and paths) per tracking kernel"}, &settings.rays);
+  parameterRegistry.add({"lookups", "Density lookups per sampling kernel"}, &settings.lookups);
+  parameterRegistry.add({"max-depth", "Scattering events per random-walk path"},
+                        &settings.maxDepth);
+  parameterRegistry.add({"repeat", "Runs per kernel, the fastest is reported"},
+                        &settings.repeat);
+  parameterRegistry.add({"seed", "Workload seed"}, &settings.seed);
+  parameterRegistry.add({"estimates", "Transmittance estimates per ray for the variance table"},
+                        &settings.estimates);
+  parameterParser.add(parameterRegistry);
+  parameterParser.parse(argc, argv);
+
+  if (settings.volumePath.empty()) {
+    fprintf(stderr, "peacock_bench: --volume is required\n");
+    return 1;
+  }
+  settings.rays = std::max(settings.rays, 1u);
+  settings.lookups = std::max(settings.lookups, 1u);
+
+  // ── Scene ───────────────────────────────────────────────────────────────────
+  VolumeLoadOptions loadOptions;
+  loadOptions.useCache = settings.volumeCache;
+  loadOptions.precision = parseVolumePrecision(settings.precision);
+  loadOptions.tolerance = settings.tolerance;
+  const HostVolume volume = HostVolume::load(settings.volumePath, loadOptions);
+
+  shaderio::VolumeDesc desc{};
+  const MajorantGrid majorants = volume.visit([&](const auto& grid) {
+    desc = makeVolumeDesc(grid);
+    return MajorantGrid::build(grid, settings.majorantCellSize);
+  });
+  majorants.describe(desc);
+  if (settings.densityScale > 0.0f) {
+    desc.densityScale = settings.densityScale;
+  }
+
+  VolumeKernels kernels(volume, desc, majorants);
+  PerfCounters perf;
+
+  const std::vector<BoundedRay> rays = makeRays(desc, settings.rays, settings.seed);
+  const std::vector<glm::vec3> coherent = makeLookups(rays, settings.lookups);
+  std::vector<glm::vec3> shuffled = coherent;
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(settings.seed));
+
+  // ── Kernels ─────────────────────────────────────────────────────────────────
+  std::vector<KernelResult> results;
+  const uint32_t repeat = settings.repeat;
+
+  results.push_back(runKernel("sample (ray order)", coherent.size(), repeat, kernels, perf, [&] {
+    float sum = 0.0f;
+    for (const glm::vec3& p : coherent) {
+      sum += kernels.sample(p);
+    }
+    return sum;
+  }));
+
+  results.push_back(runKernel("sample (shuffled)", shuffled.size(), repeat, kernels, perf, [&] {
+    float sum = 0.0f;
+    for (const glm::vec3& p : shuffled) {
+      sum += kernels.sample(p);
+    }
+    return sum;
+  }));
+
+  results.push_back(runKernel("sample_distance", rays.size(), repeat, kernels, perf, [&] {
+    float sum = 0.0f;
+    for (size_t i = 0; i < rays.size(); ++i) {
+      RandomSampler rng{static_cast<uint32_t>(i) * 747796405u + settings.seed};
+      const DistanceSample ds = kernels.sampleDistance(rays[i].ray, rays[i].tMin, rays[i].tMax, rng);
+      sum += ds.event == DistanceEvent::eScatter ? ds.pos.x : 0.0f;
+    }
+    return sum;
+  }));
+
+  const struct {
+    const char* name;
+    shaderio::TransmittanceEstimator estimator;
+  } estimators[] = {
+      {"tr ratio", shaderio::eTransmittanceRatio},
+      {"tr residual ratio", shaderio::eTransmittanceResidualRatio},
+      {"tr track length", shaderio::eTransmittanceTrackLength},
+  };
+  for (const auto& e : estimators) {
+    results.push_back(runKernel(e.name, rays.size(), repeat, kernels, perf, [&] {
+      float sum = 0.0f;
+      for (size_t i = 0; i < rays.size(); ++i) {
+        RandomSampler rng{static_cast<uint32_t>(i) * 747796405u + settings.seed};
+        sum += kernels.evalTransmittance(rays[i].ray, rays[i].tMin, rays[i].tMax, rng, e.estimator);
+      }
+      return sum;
+    }));
+  }
+
+  // Variance per shadow ray: --estimates independent estimates of every ray, the
+  // unbiased sample variance averaged over the rays. Variance x lookups is the
+  // cost of a given noise level, lower is better.
+  struct EstimatorStats {
+    const char* name;
+    double mean{0.0};
+    double variance{0.0};
+    double lookups{0.0};
+  };
+  std::vector<EstimatorStats> estimatorStats;
+  const uint32_t estimates = std::max(settings.estimates, 2u);
+  for (const auto& e : estimators) {
+    EstimatorStats stats{e.name};
+    kernels.counters = {};
+    for (size_t i = 0; i < rays.size(); ++i) {
+      RandomSampler rng{static_cast<uint32_t>(i) * 2891336453u + settings.seed};
+      double sum = 0.0;
+      double sumSquares = 0.0;
+      for (uint32_t n = 0; n < estimates; ++n) {
+        const double tr = kernels.evalTransmittance(rays[i].ray, rays[i].tMin, rays[i].tMax, rng,
+                                                    e.estimator);
+        sum += tr;
+        sumSquares += tr * tr;
+      }
+      stats.mean += sum / estimates;
+      stats.variance += (sumSquares - sum * sum / estimates) / (estimates - 1);
+    }
+    const double estimateCount = static_cast<double>(rays.size()) * estimates;
+    stats.mean /= rays.size();
+    stats.variance /= rays.size();
+    stats.lookups = kernels.counters.densityLookups / estimateCount;
+    estimatorStats.push_back(stats);
+  }
+
+  results.push_back(runKernel("hg sample_p", settings.lookups, repeat, kernels, perf, [&] {
+    RandomSampler rng{settings.seed};
+    glm::vec3 wo(0.0f, 0.0f, 1.0f);
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < settings.lookups; ++i) {
+      const PhaseSample ps = sampleHG(wo, rng.nextFloat2(), desc.g);
+      sum += ps.pdf;
+      wo = ps.wi;
+    }
+    return sum;
+  }));
+
+  // Random walk shaped like renderer.slang's trace loop: delta tracking to the next
+  // scatter, a ratio-tracked shadow ray towards a fixed light, HG continuation.
+  const glm::vec3 lightDir = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+  results.push_back(runKernel("path (walk + NEE)", rays.size(), repeat, kernels, perf, [&] {
+    float sum = 0.0f;
+    for (size_t i = 0; i < rays.size(); ++i) {
+      RandomSampler rng{static_cast<uint32_t>(i) * 747796405u + settings.seed};
+      Ray ray = rays[i].ray;
+      for (uint32_t depth = 0; depth < settings.maxDepth; ++depth) {
+        const auto hit = intersectBox(ray, desc.bboxMin, desc.bboxMax);
+        if (!hit) {
+          break;
+        }
+        const DistanceSample ds =
+            kernels.sampleDistance(ray, std::max(hit->x, 0.0f), hit->y, rng);
+        if (ds.event != DistanceEvent::eScatter) {
+          break;
+        }
+
+        const Ray shadowRay{ds.pos, lightDir};
+        if (const auto shadowHit = intersectBox(shadowRay, desc.bboxMin, desc.bboxMax)) {
+          sum += kernels.evalTransmittance(shadowRay, std::max(shadowHit->x, 1e-4f),
+                                           shadowHit->y, rng);
+        }
+        ray = {ds.pos, sampleHG(ray.d, rng.nextFloat2(), desc.g).wi};
+      }
+    }
+    return sum;
+  }));
+
+  // ── Report ──────────────────────────────────────────────────────────────────
+  size_t activeCells = 0;
+  for (float bound : majorants.maxDensity) {
+    activeCells += bound > 0.0f ? 1 : 0;
+  }
+  printf("\n[Bench] %s, %s grid (%.1f MB), majorant grid %ux%ux%u (%zu active), density x%.3g\n",
+         settings.volumePath.filename().string().c_str(), settings.precision.c_str(),
+         volume.size() / (1024.0 * 1024.0), majorants.resolution.x, majorants.resolution.y,
+         majorants.resolution.z, activeCells, desc.densityScale);
+  printf("[Bench] best of %u runs, single thread; accessor = leaf/lower/upper/root %% of voxel "
+         "reads; misses per lookup (per op without lookups)\n\n",
+         std::max(settings.repeat, 1u));
+  printf("%-22s %9s %10s %11s %9s %7s  %23s %9s %9s\n", "kernel", "ops", "ns/op", "lookups/op",
+         "ns/lookup", "null", "accessor hit %", "L1D miss", "LLC miss");
+  for (const KernelResult& result : results) {
+    printResult(result, perf.available());
+  }
+
+  printf("\n[Bench] transmittance estimators, %u estimates per ray\n\n", estimates);
+  printf("%-22s %10s %11s %12s %14s\n", "estimator", "mean Tr", "lookups/ray", "variance",
+         "var x lookups");
+  for (const EstimatorStats& stats : estimatorStats) {
+    printf("%-22s %10.5f %11.2f %12.3e %14.3e\n", stats.name, stats.mean, stats.lookups,
+           stats.variance, stats.variance * stats.lookups);
+  }
+  return 0;
+}
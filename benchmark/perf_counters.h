@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+namespace peacock::bench {
+
+// Hardware cache counters of the calling thread (Linux perf events). Everything is a
+// no-op when perf is unavailable (other platforms, containers, perf_event_paranoid),
+// in which case available() is false and the report prints "n/a".
+class PerfCounters {
+public:
+  struct Values {
+    uint64_t l1dReadMisses{0};
+    uint64_t llcMisses{0};
+  };
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool available() const { return m_l1d >= 0 && m_llc >= 0; }
+
+  void start();
+  Values stop();
+
+private:
+  int m_l1d{-1};
+  int m_llc{-1};
+};
+
+}  // namespace peacock::bench
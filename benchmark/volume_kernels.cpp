@@ -0,0 +1,323 @@
+#include "volume_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define PNANOVDB_C
+#include <nanovdb/PNanoVDB.h>
+
+namespace peacock::bench {
+
+namespace {
+
+constexpr float k2Pi = 6.28318530717958647692f;
+constexpr float kInv4Pi = 0.07957747154594766788f;
+
+float safeSqrt(float v) { return std::sqrt(std::max(v, 0.0f)); }
+
+glm::vec3 frameToWorld(const glm::vec3& n, const glm::vec3& v) {
+  glm::vec3 s, t;
+  if (n.z < -0.99999f) {
+    s = {0.0f, -1.0f, 0.0f};
+    t = {-1.0f, 0.0f, 0.0f};
+  } else {
+    const float a = 1.0f / (1.0f + n.z);
+    const float b = -n.x * n.y * a;
+    s = {1.0f - n.x * n.x * a, b, -n.x};
+    t = {b, 1.0f - n.y * n.y * a, -n.y};
+  }
+  return v.x * s + v.y * t + v.z * n;
+}
+
+struct GridView {
+  pnanovdb_buf_t buf;
+  pnanovdb_grid_handle_t grid;
+  uint32_t gridType;
+
+  pnanovdb_root_handle_t root() const {
+    return pnanovdb_tree_get_root(buf, pnanovdb_grid_get_tree(buf, grid));
+  }
+  pnanovdb_readaccessor_t accessor() const {
+    pnanovdb_readaccessor_t acc;
+    pnanovdb_readaccessor_init(&acc, root());
+    return acc;
+  }
+  glm::vec3 worldToIndex(const glm::vec3& p) const {
+    const pnanovdb_vec3_t src{p.x, p.y, p.z};
+    const pnanovdb_vec3_t idx = pnanovdb_grid_world_to_indexf(buf, grid, &src);
+    return {idx.x, idx.y, idx.z};
+  }
+  glm::vec3 worldToIndexDir(const glm::vec3& d) const {
+    const pnanovdb_vec3_t src{d.x, d.y, d.z};
+    const pnanovdb_vec3_t idx = pnanovdb_grid_world_to_index_dirf(buf, grid, &src);
+    return {idx.x, idx.y, idx.z};
+  }
+
+  // NanovdbVolume::read, plus the accessor level that resolved the lookup.
+  float read(pnanovdb_readaccessor_t& acc, const pnanovdb_coord_t& ijk,
+             KernelCounters& counters) const {
+    const int dirty = pnanovdb_readaccessor_computedirty(&acc, &ijk);
+    const int cached = pnanovdb_readaccessor_iscached0(&acc, dirty)   ? 0
+                       : pnanovdb_readaccessor_iscached1(&acc, dirty) ? 1
+                       : pnanovdb_readaccessor_iscached2(&acc, dirty) ? 2
+                                                                      : 3;
+    ++counters.accessorLevel[cached];
+    ++counters.voxelReads;
+
+    pnanovdb_uint32_t level = 0;
+    const pnanovdb_address_t address =
+        pnanovdb_readaccessor_get_value_address_and_level(gridType, buf, &acc, &ijk, &level);
+    switch (gridType) {
+      case PNANOVDB_GRID_TYPE_FP4:  return pnanovdb_root_fp4_read_float(buf, address, &ijk, level);
+      case PNANOVDB_GRID_TYPE_FP8:  return pnanovdb_root_fp8_read_float(buf, address, &ijk, level);
+      case PNANOVDB_GRID_TYPE_FP16: return pnanovdb_root_fp16_read_float(buf, address, &ijk, level);
+      case PNANOVDB_GRID_TYPE_FPN:  return pnanovdb_root_fpn_read_float(buf, address, &ijk, level);
+      default:                      return pnanovdb_read_float(buf, address);
+    }
+  }
+};
+
+GridView makeView(uint32_t* words, uint32_t gridType) {
+  return {pnanovdb_make_buf(words, 0), {}, gridType};
+}
+
+uint32_t readGridType(uint32_t* words) {
+  return pnanovdb_grid_get_grid_type(pnanovdb_make_buf(words, 0), pnanovdb_grid_handle_t{});
+}
+
+// ── medium.slang: DDAMajorantIterator ─────────────────────────────────────────
+struct MajorantSegment {
+  float sigmaMaj;
+  float sigmaC;
+  float tMin;
+  float tMax;
+};
+
+class MajorantIterator {
+public:
+  MajorantIterator(const GridView& view, const Ray& ray, float tMin, float tMax,
+                   const MajorantGrid& majorants, float sigmaT)
+      : m_majorants(majorants), m_sigmaT(sigmaT), m_tMin(tMin), m_tMax(tMax) {
+    const float cellSize = static_cast<float>(majorants.cellSize);
+    const glm::vec3 o = (view.worldToIndex(ray.o) - majorants.origin) / cellSize;
+    glm::vec3 d = view.worldToIndexDir(ray.d) / cellSize;
+    const glm::vec3 pGrid = o + tMin * d;
+
+    for (int axis = 0; axis < 3; ++axis) {
+      if (d[axis] == -0.0f) {
+        d[axis] = 0.0f;  // -0 would pass the test below but divide to -inf
+      }
+      const int res = static_cast<int>(majorants.resolution[axis]);
+      m_voxel[axis] = std::clamp(static_cast<int>(std::floor(pGrid[axis])), 0, res - 1);
+      if (d[axis] >= 0.0f) {
+        m_nextCrossingT[axis] = tMin + (static_cast<float>(m_voxel[axis] + 1) - pGrid[axis]) / d[axis];
+        m_deltaT[axis] = 1.0f / d[axis];
+        m_step[axis] = 1;
+        m_voxelLimit[axis] = res;
+      } else {
+        m_nextCrossingT[axis] = tMin + (static_cast<float>(m_voxel[axis]) - pGrid[axis]) / d[axis];
+        m_deltaT[axis] = -1.0f / d[axis];
+        m_step[axis] = -1;
+        m_voxelLimit[axis] = -1;
+      }
+    }
+  }
+
+  std::optional<MajorantSegment> next() {
+    while (m_tMin < m_tMax) {
+      int axis = 0;
+      if (m_nextCrossingT.y < m_nextCrossingT[axis]) axis = 1;
+      if (m_nextCrossingT.z < m_nextCrossingT[axis]) axis = 2;
+
+      const float tCellExit = std::min(m_tMax, m_nextCrossingT[axis]);
+      const glm::ivec3 res(m_majorants.resolution);
+      const size_t cell = (static_cast<size_t>(m_voxel.z) * res.y + m_voxel.y) * res.x + m_voxel.x;
+      const float bound = m_majorants.maxDensity[cell];
+      const MajorantSegment seg{m_sigmaT * bound, m_sigmaT * m_majorants.meanDensity[cell], m_tMin,
+                                tCellExit};
+
+      m_tMin = tCellExit;
+      if (m_nextCrossingT[axis] > m_tMax) m_tMin = m_tMax;
+      m_voxel[axis] += m_step[axis];
+      if (m_voxel[axis] == m_voxelLimit[axis]) m_tMin = m_tMax;
+      m_nextCrossingT[axis] += m_deltaT[axis];
+
+      if (bound > 0.0f && seg.tMax > seg.tMin) {
+        return seg;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  const MajorantGrid& m_majorants;
+  float m_sigmaT;
+  float m_tMin;
+  float m_tMax;
+  glm::vec3 m_nextCrossingT{0.0f};
+  glm::vec3 m_deltaT{0.0f};
+  glm::ivec3 m_step{0};
+  glm::ivec3 m_voxelLimit{0};
+  glm::ivec3 m_voxel{0};
+};
+
+}  // namespace
+
+std::optional<glm::vec2> intersectBox(const Ray& ray, const glm::vec3& boxMin,
+                                      const glm::vec3& boxMax) {
+  const glm::vec3 invDir = 1.0f / ray.d;
+  const glm::vec3 t0 = (boxMin - ray.o) * invDir;
+  const glm::vec3 t1 = (boxMax - ray.o) * invDir;
+  const glm::vec3 hitMin = glm::min(t0, t1);
+  const glm::vec3 hitMax = glm::max(t0, t1);
+  const float tMin = std::max(std::max(hitMin.x, hitMin.y), hitMin.z);
+  const float tMax = std::min(std::min(hitMax.x, hitMax.y), hitMax.z);
+  if (tMin < tMax && tMax > 0.0f) {
+    return glm::vec2(tMin, tMax);
+  }
+  return std::nullopt;
+}
+
+PhaseSample sampleHG(const glm::vec3& wo, glm::vec2 u, float g) {
+  float cosTheta;
+  if (std::abs(g) < 1e-3f) {
+    cosTheta = 1.0f - 2.0f * u.x;
+  } else {
+    const float xi = (1.0f - g * g) / (1.0f - g + 2.0f * g * u.x);
+    cosTheta = (1.0f + g * g - xi * xi) / (2.0f * g);
+  }
+  cosTheta = std::clamp(cosTheta, -1.0f, 1.0f);
+
+  const float sinTheta = safeSqrt(1.0f - cosTheta * cosTheta);
+  const float phi = k2Pi * u.y;
+  const glm::vec3 wi = frameToWorld(
+      wo, glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+  const float denom = 1.0f + g * g + 2.0f * g * cosTheta;
+  return {wi, kInv4Pi * (1.0f - g * g) / (denom * safeSqrt(denom))};
+}
+
+// PNanoVDB never writes through the buffer; the words pointer is only non-const
+// because pnanovdb_buf_t is shared with the read-write API.
+VolumeKernels::VolumeKernels(const HostVolume& volume, const shaderio::VolumeDesc& desc,
+                             const MajorantGrid& majorants)
+    : m_words(static_cast<uint32_t*>(const_cast<void*>(volume.data()))),
+      m_gridType(readGridType(m_words)),
+      m_desc(desc),
+      m_majorants(majorants) {}
+
+float VolumeKernels::sample(const glm::vec3& pos) {
+  const GridView view = makeView(m_words, m_gridType);
+  // A fresh accessor per call, as in the shader.
+  pnanovdb_readaccessor_t acc = view.accessor();
+  ++counters.densityLookups;
+
+  const glm::vec3 idx = view.worldToIndex(pos);
+  const glm::ivec3 i0(glm::floor(idx));
+  const glm::vec3 t = idx - glm::vec3(i0);
+
+  auto corner = [&](int dx, int dy, int dz) {
+    const pnanovdb_coord_t ijk{i0.x + dx, i0.y + dy, i0.z + dz};
+    return view.read(acc, ijk, counters);
+  };
+  const float c000 = corner(0, 0, 0);
+  const float c100 = corner(1, 0, 0);
+  const float c010 = corner(0, 1, 0);
+  const float c110 = corner(1, 1, 0);
+  const float c001 = corner(0, 0, 1);
+  const float c101 = corner(1, 0, 1);
+  const float c011 = corner(0, 1, 1);
+  const float c111 = corner(1, 1, 1);
+
+  const float c00 = glm::mix(c000, c100, t.x);
+  const float c10 = glm::mix(c010, c110, t.x);
+  const float c01 = glm::mix(c001, c101, t.x);
+  const float c11 = glm::mix(c011, c111, t.x);
+  const float c0 = glm::mix(c00, c10, t.y);
+  const float c1 = glm::mix(c01, c11, t.y);
+  return glm::mix(c0, c1, t.z);
+}
+
+DistanceSample VolumeKernels::sampleDistance(const Ray& ray, float tMin, float tMax,
+                                             RandomSampler& rng) {
+  const float sigmaT = (m_desc.sigma_a.x + m_desc.sigma_s.x) * m_desc.densityScale;
+  MajorantIterator iter(makeView(m_words, m_gridType), ray, tMin, tMax, m_majorants, sigmaT);
+  while (const auto seg = iter.next()) {
+    ++counters.majorantSegments;
+    const float sigmaMaj = seg->sigmaMaj;
+    float t = seg->tMin;
+    while (true) {
+      t -= std::log(std::max(rng.nextFloat(), 1e-6f)) / sigmaMaj;
+      if (t >= seg->tMax) {
+        break;
+      }
+
+      const glm::vec3 pos = ray.o + t * ray.d;
+      const float density = sample(pos) * m_desc.densityScale;
+      const float sigmaS = m_desc.sigma_s.x * density;
+      const float sigmaTPoint = m_desc.sigma_a.x * density + sigmaS;
+
+      ++counters.collisions;
+      const float u = rng.nextFloat();
+      if (u < sigmaS / sigmaMaj) {
+        return {DistanceEvent::eScatter, pos};
+      }
+      if (u < sigmaTPoint / sigmaMaj) {
+        return {DistanceEvent::eAbsorb, pos};
+      }
+      counters.nullCollisions += 1.0;
+    }
+  }
+  return {DistanceEvent::eEscape, ray.o + tMax * ray.d};
+}
+
+// RatioTracking / ResidualRatioTracking / TrackLength of sampler.slang, unrolled
+// into one loop: the control, the tracking rate and the collision weight.
+float VolumeKernels::evalTransmittance(const Ray& ray, float tMin, float tMax, RandomSampler& rng,
+                                       shaderio::TransmittanceEstimator estimator) {
+  const float sigmaT = (m_desc.sigma_a.x + m_desc.sigma_s.x) * m_desc.densityScale;
+  MajorantIterator iter(makeView(m_words, m_gridType), ray, tMin, tMax, m_majorants, sigmaT);
+  const bool residual = estimator == shaderio::eTransmittanceResidualRatio;
+  float tr = 1.0f;
+  while (const auto seg = iter.next()) {
+    ++counters.majorantSegments;
+    const float sigmaC = residual ? std::min(seg->sigmaC, seg->sigmaMaj) : 0.0f;
+    const float rate =
+        residual ? std::max(seg->sigmaMaj - sigmaC, seg->sigmaMaj * (1.0f / 16.0f)) : seg->sigmaMaj;
+    tr *= std::exp(-sigmaC * (seg->tMax - seg->tMin));
+
+    float t = seg->tMin;
+    while (true) {
+      t -= std::log(std::max(rng.nextFloat(), 1e-6f)) / rate;
+      if (t >= seg->tMax) {
+        break;
+      }
+
+      const float density = sample(ray.o + t * ray.d) * m_desc.densityScale;
+      const float sigmaTPoint = (m_desc.sigma_a.x + m_desc.sigma_s.x) * density;
+      ++counters.collisions;
+      float weight;
+      if (estimator == shaderio::eTransmittanceTrackLength) {
+        weight = rng.nextFloat() < sigmaTPoint / rate ? 0.0f : 1.0f;
+        counters.nullCollisions += weight;
+      } else {
+        weight = std::max(1.0f - (sigmaTPoint - sigmaC) / rate, 0.0f);
+        counters.nullCollisions += std::max(rate - sigmaTPoint, 0.0f) / rate;
+      }
+      tr *= weight;
+      if (tr == 0.0f) {
+        return 0.0f;
+      }
+
+      if (tr < 0.01f) {
+        const float q = std::max(0.05f, 1.0f - tr);
+        if (rng.nextFloat() < q) {
+          return 0.0f;
+        }
+        tr /= (1.0f - q);
+      }
+    }
+  }
+  return tr;
+}
+
+}  // namespace peacock::bench
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <glm/glm.hpp>
+
+#include "peacock/scene/host_volume.h"
+#include "peacock/scene/majorant_grid.h"
+#include "peacock/shaderio.h"
+
+namespace peacock::bench {
+
+// CPU twins of the GPU volume kernels, built on PNanoVDB.h (the C version of the
+// PNanoVDB.slang the shaders include), so voxel fetches take the exact accessor
+// path of NanovdbVolume::sample. Everything is single-threaded and instrumented;
+// keep the functions in sync with the Slang modules named in the comments.
+
+// Event counts gathered while a kernel runs.
+struct KernelCounters {
+  uint64_t densityLookups{0};  // NanovdbVolume::sample calls (trilinear, 8 voxel reads)
+  uint64_t voxelReads{0};
+  // Level at which the read accessor resolved each voxel read: cached leaf, cached
+  // lower node, cached upper node, or a full traversal from the root.
+  uint64_t accessorLevel[4]{};
+  uint64_t majorantSegments{0};
+  // Tentative collisions of the trackers, and how many of them were null. Ratio
+  // tracking never decides, so it adds its null fraction sigma_n / sigma_maj instead.
+  uint64_t collisions{0};
+  double nullCollisions{0.0};
+};
+
+// ── random.slang ──────────────────────────────────────────────────────────────
+struct RandomSampler {
+  uint32_t state;
+
+  uint32_t nextUint() {
+    state = state * 747796405u + 1u;
+    const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+  }
+  // to_unit_float: the top 24 bits fill the mantissa, so the result stays in [0, 1)
+  float nextFloat() { return static_cast<float>(nextUint() >> 8u) * (1.0f / 16777216.0f); }
+  glm::vec2 nextFloat2() {
+    const float x = nextFloat();
+    return {x, nextFloat()};
+  }
+};
+
+struct Ray {
+  glm::vec3 o;
+  glm::vec3 d;
+};
+
+// math.slang ray_box_intersect: [tMin, tMax] of the ray inside the box, if any.
+std::optional<glm::vec2> intersectBox(const Ray& ray, const glm::vec3& boxMin,
+                                      const glm::vec3& boxMax);
+
+// ── phase/henyey_greenstein.slang: HGPhaseFunction::sample_p ──────────────────
+struct PhaseSample {
+  glm::vec3 wi;
+  float pdf;
+};
+PhaseSample sampleHG(const glm::vec3& wo, glm::vec2 u, float g);
+
+// ── sampler.slang: sample_distance outcome ────────────────────────────────────
+enum class DistanceEvent { eScatter, eAbsorb, eEscape };
+
+struct DistanceSample {
+  DistanceEvent event;
+  glm::vec3 pos;
+};
+
+// The heterogeneous NanoVDB medium of renderer.slang: NanovdbVolume density,
+// HeterogeneousMedium optical properties and the DDA majorant iterator.
+class VolumeKernels {
+public:
+  VolumeKernels(const HostVolume& volume, const shaderio::VolumeDesc& desc,
+                const MajorantGrid& majorants);
+
+  // volume/nanovdb.slang: NanovdbVolume::sample, raw (unscaled) density.
+  float sample(const glm::vec3& pos);
+
+  // sampler.slang: sample_distance / estimate_transmittance over [tMin, tMax].
+  DistanceSample sampleDistance(const Ray& ray, float tMin, float tMax, RandomSampler& rng);
+  float evalTransmittance(const Ray& ray, float tMin, float tMax, RandomSampler& rng,
+                          shaderio::TransmittanceEstimator estimator = shaderio::eTransmittanceRatio);
+
+  const shaderio::VolumeDesc& desc() const { return m_desc; }
+
+  KernelCounters counters;
+
+private:
+  uint32_t* m_words;  // NanoVDB bytes as PNanoVDB buffer words (read only)
+  uint32_t m_gridType;
+  shaderio::VolumeDesc m_desc;
+  const MajorantGrid& m_majorants;
+};
+
+}  // namespace peacock::bench
@@ -1,15 +1,146 @@
+#include <algorithm>
 #include <memory>
 #include <nvapp/application.hpp>
 #include <nvapp/elem_default_menu.hpp>
 #include <nvapp/elem_default_title.hpp>
 #include <nvvk/context.hpp>
 #include <nvapp/elem_camera.hpp>
+#include <nvutils/file_operations.hpp>
+#include <nvutils/parameter_parser.hpp>
+#include <nvutils/parameter_registry.hpp>
 
+#include "peacock/cpu/cpu_renderer.h"
 #include "peacock/raytracer.h"
 
 using namespace peacock;
 
-int main() {
+int main(int argc, char **argv) {
+  //--------------------------------------------------------------------------------------------------
+  // Command line
+  RaytracerSettings settings;
+  glm::uvec2 windowSize{0, 0};
+
+  nvutils::ParameterRegistry parameterRegistry;
+  nvutils::ParameterParser parameterParser(nvutils::getExecutablePath().stem().string());
+  parameterRegistry.add({"volume", "VDB file to render"}, &settings.volumePath);
+  parameterRegistry.add({"scene", "Multi-volume scene file, replaces --volume"},
+                        &settings.scenePath);
+  parameterRegistry.add({"hdr", "Equirectangular HDR environment"}, &settings.hdrPath);
+  parameterRegistry.add({"sun-direction", "Direction towards the directional sun light"},
+                        &settings.sunDirection);
+  parameterRegistry.add({"sun-radiance", "Sun irradiance (r g b, 0 = no sun)"},
+                        &settings.sunRadiance);
+  parameterRegistry.add({"light-candidates",
+                         "Light candidates resampled per shadow ray (0 = plain NEE with MIS)"},
+                        &settings.lightCandidates);
+  parameterRegistry.add({"light-reuse", "Reservoir reuse: none, temporal, spatial or both"},
+                        &settings.lightReuse);
+  parameterRegistry.add({"eye", "Camera position (default: framed on the volume)"}, &settings.eye);
+  parameterRegistry.add({"center", "Camera look-at point"}, &settings.center);
+  parameterRegistry.add({"up", "Camera up vector"}, &settings.up);
+  parameterRegistry.add({"fov", "Camera vertical field of view in degrees"}, &settings.fov);
+  parameterRegistry.add({"size", "Render resolution (width height)"}, &windowSize);
+  parameterRegistry.add({"headless", "Render offline without a window and write --output"},
+                        &settings.headless, true);
+  parameterRegistry.add({"output", "Offline output image (.exr or .pfm)"}, &settings.outputPath);
+  parameterRegistry.add({"spp", "Offline target samples per pixel"}, &settings.targetSpp);
+  parameterRegistry.add({"spp-per-dispatch", "Offline samples per pixel per dispatch"},
+                        &settings.sppPerDispatch);
+  parameterRegistry.add({"dispatches-per-frame", "Offline dispatches per submitted frame"},
+                        &settings.dispatchesPerFrame);
+  parameterRegistry.add({"backend",
+                         "GPU backend: auto, raytracing, compute, compute-morton or wavefront"},
+                        &settings.backend);
+  parameterRegistry.add({"wavefront-sort", "Sort wavefront queues by NanoVDB leaf"},
+                        &settings.wavefrontSort);
+  parameterRegistry.add({"sampler", "Path sample sequence: sobol, rank1 or independent"},
+                        &settings.sampler);
+  parameterRegistry.add({"transmittance",
+                         "Shadow-ray transmittance estimator: residual, ratio or track-length"},
+                        &settings.transmittance);
+  parameterRegistry.add({"cpu", "Render offline on the CPU reference backend (no Vulkan)"},
+                        &settings.cpu, true);
+  parameterRegistry.add({"cpu-threads", "CPU backend worker threads (0 = all cores)"},
+                        &settings.cpuThreads);
+  parameterRegistry.add({"cpu-tile", "CPU backend tile size in pixels"}, &settings.cpuTileSize);
+  parameterRegistry.add({"volume-cache", "Use the .nvdb sidecar cache next to the volume"},
+                        &settings.volumeCache);
+  parameterRegistry.add({"volume-precision", "Density grid type: float, fp16, fp8, fp4 or fpn"},
+                        &settings.volumePrecision);
+  parameterRegistry.add({"volume-tolerance", "Absolute error bound of --volume-precision fpn"},
+                        &settings.volumeTolerance);
+  parameterRegistry.add({"sequence", "Play --volume as the first frame of a numbered sequence"},
+                        &settings.sequence, true);
+  parameterRegistry.add({"sequence-fps", "Sequence playback rate"}, &settings.sequenceFps);
+  parameterRegistry.add({"sequence-threads", "Sequence loader threads"},
+                        &settings.sequenceThreads);
+  parameterRegistry.add({"noise-threshold", "Adaptive sampling relative error target (0 = off)"},
+                        &settings.noiseThreshold);
+  parameterRegistry.add({"adaptive-min-spp", "Samples per pixel before convergence is tested"},
+                        &settings.adaptiveMinSpp);
+  parameterRegistry.add({"reproject", "Reproject the accumulated image when the camera moves"},
+                        &settings.reproject);
+  parameterRegistry.add({"frame-budget", "Interactive GPU trace time per frame in ms (0 = fixed spp)"},
+                        &settings.frameBudgetMs);
+  parameterRegistry.add({"idle-frame-budget",
+                         "Trace time per frame once the image is still, in ms (0 = unlimited)"},
+                        &settings.idleFrameBudgetMs);
+  parameterRegistry.add({"tiled-frames", "Trace one band of the image per frame over budget"},
+                        &settings.tiledFrames);
+  parameterRegistry.add({"preview", "Show a ray-marched preview while the view or scene changes"},
+                        &settings.preview);
+  parameterRegistry.add({"denoise", "Denoise the displayed and the offline image"},
+                        &settings.denoise, true);
+  parameterRegistry.add({"denoise-passes", "Denoiser a-trous levels"}, &settings.denoisePasses);
+  parameterRegistry.add({"adaptive-stop", "Converged pixel fraction that ends the render"},
+                        &settings.adaptiveStopFraction);
+  parameterRegistry.add({"stats-csv", "Stream per-frame GPU timings to this CSV file"},
+                        &settings.statsCsvPath);
+  parameterRegistry.add({"majorant-cell", "Majorant grid cell size in voxels"},
+                        &settings.majorantCellSize);
+  parameterRegistry.add({"lod-levels", "Coarse density levels built per volume (0-3)"},
+                        &settings.lodLevels);
+  parameterRegistry.add({"lod-depth", "Scatter depth from which paths use coarse levels (0 = off)"},
+                        &settings.lodDepth);
+  parameterRegistry.add({"lod-shadow-depth",
+                         "Scatter depth from which shadow rays use coarse levels (0 = off)"},
+                        &settings.lodShadowDepth);
+  parameterRegistry.add({"shadow-cache-depth",
+                         "Scatter depth from which shadow rays read the transmittance cache (0 = off)"},
+                        &settings.transmittanceCacheDepth);
+  parameterRegistry.add({"shadow-cache-res", "Transmittance cache cells per axis (2-128)"},
+                        &settings.transmittanceCacheRes);
+  parameterRegistry.add({"reference", "Offline: report the difference to this .exr/.pfm image"},
+                        &settings.referencePath);
+  parameterRegistry.add({"pipeline-cache", "Persist the Vulkan pipeline cache between runs"},
+                        &settings.pipelineCache);
+  parameterRegistry.add({"pipeline-cache-path", "Pipeline cache file (default: next to the executable)"},
+                        &settings.pipelineCachePath);
+  parameterRegistry.add({"specialize", "Run pipeline variants specialized for the scene"},
+                        &settings.specializePipelines);
+  parameterRegistry.add({"hot-reload", "Rebuild the shaders when their sources change"},
+                        &settings.hotReload);
+  parameterParser.add(parameterRegistry);
+  parameterParser.parse(argc, argv);
+
+  settings.targetSpp = std::max(settings.targetSpp, 1u);
+  settings.sppPerDispatch = std::max(settings.sppPerDispatch, 1u);
+  settings.dispatchesPerFrame = std::max(settings.dispatchesPerFrame, 1u);
+  settings.lodLevels = std::min(settings.lodLevels, shaderio::kMaxDensityLods);
+  settings.transmittanceCacheRes = std::clamp(settings.transmittanceCacheRes, 2u, 128u);
+  if ((settings.headless || settings.cpu) && (windowSize.x == 0 || windowSize.y == 0)) {
+    windowSize = {1280, 720};
+  }
+
+  if (settings.cpu && !settings.scenePath.empty()) {
+    LOGE("--scene is not supported by the CPU backend\n");
+    return 1;
+  }
+  if (settings.cpu) {
+    renderOnCpu(settings, windowSize.x, windowSize.y);
+    return 0;
+  }
+
   //--------------------------------------------------------------------------------------------------
   // Vulkan setup
   VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{
@@ -18,21 +149,29 @@ int main() {
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
   VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipelineFeature{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR};
+  VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeature{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
 
   nvvk::ContextInitInfo vkSetup = {
       .instanceExtensions = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME},
       .deviceExtensions =
           {
-              {VK_KHR_SWAPCHAIN_EXTENSION_NAME},
               {VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME},
-              {VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME},
               {VK_EXT_SHADER_OBJECT_EXTENSION_NAME, &shaderObjectFeatures},
-              {VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, &accelFeature},
-              {VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, &rtPipelineFeature},
+              // Optional: without them the integrator runs as a compute shader
+              {VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME, nullptr, false},
+              {VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, &accelFeature, false},
+              {VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, &rtPipelineFeature, false},
+              // Optional: multi-volume scenes fall back to testing every instance
+              {VK_KHR_RAY_QUERY_EXTENSION_NAME, &rayQueryFeature, false},
           },
       .queues = {VK_QUEUE_GRAPHICS_BIT, VK_QUEUE_TRANSFER_BIT},
   };
-  nvvk::addSurfaceExtensions(vkSetup.instanceExtensions);
+  // Headless rendering never presents, so it also runs on ICDs without WSI (e.g. lavapipe in CI)
+  if (!settings.headless) {
+    vkSetup.deviceExtensions.push_back({VK_KHR_SWAPCHAIN_EXTENSION_NAME});
+    nvvk::addSurfaceExtensions(vkSetup.instanceExtensions);
+  }
 
   // Initialize the Vulkan context
   nvvk::Context vkContext;
@@ -49,8 +188,16 @@ int main() {
       .physicalDevice = vkContext.getPhysicalDevice(),
       .queues = vkContext.getQueueInfos(),
   };
+  appInfo.windowSize = windowSize;
+  appInfo.headless = settings.headless;
+  appInfo.headlessFrameCount = settings.headlessFrameCount();
 
-  auto raytracer = std::make_shared<Raytracer>();
+  auto raytracer = std::make_shared<Raytracer>(settings);
+  // The context chains the feature structs of the extensions it enabled only, filled
+  // with what it enabled; the optional ones the device lacks stay all false.
+  raytracer->setRayTracingEnabled(
+      accelFeature.accelerationStructure == VK_TRUE && rtPipelineFeature.rayTracingPipeline == VK_TRUE,
+      accelFeature.accelerationStructure == VK_TRUE && rayQueryFeature.rayQuery == VK_TRUE);
   auto elemCamera = std::make_shared<nvapp::ElementCamera>();
 
   auto cameraManip = raytracer->getCameraManipulator();
@@ -64,7 +211,8 @@ int main() {
   application.addElement(raytracer);
   application.addElement(elemCamera);
 
-  application.run(); // Start the application, loop until the window is closed
+  application.run(); // Start the application, loop until the window is closed (or the
+                     // headless frames are rendered)
 
   application.deinit(); // Closing application
 
@@ -0,0 +1,361 @@
+#include "peacock/common/image_io.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace peacock {
+
+namespace {
+
+// Both formats are little-endian; all supported hosts are too, so values are
+// written with their in-memory representation.
+template <typename T>
+void appendValue(std::vector<char>& out, const T& value) {
+  const char* bytes = reinterpret_cast<const char*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void appendString(std::vector<char>& out, const char* str) {
+  out.insert(out.end(), str, str + std::strlen(str) + 1);  // includes '\0'
+}
+
+// One EXR header attribute: name, type, byte size, then the payload.
+void appendAttribute(std::vector<char>& out, const char* name, const char* type,
+                     const std::vector<char>& payload) {
+  appendString(out, name);
+  appendString(out, type);
+  appendValue(out, static_cast<int32_t>(payload.size()));
+  out.insert(out.end(), payload.begin(), payload.end());
+}
+
+void checkImage(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                std::span<const float> rgb) {
+  if (width == 0 || height == 0 ||
+      rgb.size() != static_cast<size_t>(width) * static_cast<size_t>(height) * 3) {
+    throw std::runtime_error("Invalid image dimensions for: " + path.string());
+  }
+}
+
+std::vector<char> readFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    throw std::runtime_error("Failed to open image: " + path.string());
+  }
+  std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(bytes.data(), static_cast<std::streamsize>(bytes.size()))) {
+    throw std::runtime_error("Failed to read image: " + path.string());
+  }
+  return bytes;
+}
+
+// Bounds-checked little-endian reader over a file's bytes.
+class ByteReader {
+public:
+  ByteReader(const std::filesystem::path& path, const std::vector<char>& bytes)
+      : m_path(path), m_bytes(bytes) {}
+
+  template <typename T>
+  T value() {
+    T v;
+    std::memcpy(&v, take(sizeof(T)), sizeof(T));
+    return v;
+  }
+  std::string string() {
+    const auto end = std::find(m_bytes.begin() + static_cast<std::ptrdiff_t>(m_pos), m_bytes.end(), '\0');
+    if (end == m_bytes.end()) {
+      fail();
+    }
+    std::string s(m_bytes.begin() + static_cast<std::ptrdiff_t>(m_pos), end);
+    m_pos += s.size() + 1;
+    return s;
+  }
+  const char* take(size_t size) {
+    if (size > m_bytes.size() - m_pos) {
+      fail();
+    }
+    const char* data = m_bytes.data() + m_pos;
+    m_pos += size;
+    return data;
+  }
+  void seek(uint64_t pos) {
+    if (pos > m_bytes.size()) {
+      fail();
+    }
+    m_pos = static_cast<size_t>(pos);
+  }
+  size_t position() const { return m_pos; }
+
+  [[noreturn]] void fail() const {
+    throw std::runtime_error("Truncated or malformed image: " + m_path.string());
+  }
+
+private:
+  const std::filesystem::path& m_path;
+  const std::vector<char>& m_bytes;
+  size_t m_pos{0};
+};
+
+Image readImagePfm(const std::filesystem::path& path) {
+  const std::vector<char> bytes = readFile(path);
+  // Header: "PF", width height, scale (negative = little-endian), one whitespace each
+  std::string header;
+  size_t pos = 0;
+  for (int fields = 0; fields < 4 && pos < bytes.size(); ++pos) {
+    const bool space = std::isspace(static_cast<unsigned char>(bytes[pos])) != 0;
+    if (space && !header.empty() && header.back() != ' ') {
+      header += ' ';
+      ++fields;
+    } else if (!space) {
+      header += bytes[pos];
+    }
+  }
+  char magic[3] = {};
+  Image image;
+  float scale = 0.0f;
+  if (std::sscanf(header.c_str(), "%2s %u %u %f", magic, &image.width, &image.height, &scale) != 4 ||
+      std::string(magic) != "PF" || scale >= 0.0f || image.width == 0 || image.height == 0) {
+    throw std::runtime_error("Unsupported PFM (expected little-endian RGB): " + path.string());
+  }
+  const size_t rowFloats = static_cast<size_t>(image.width) * 3;
+  if (bytes.size() - pos < rowFloats * image.height * sizeof(float)) {
+    throw std::runtime_error("Truncated or malformed image: " + path.string());
+  }
+  image.rgb.resize(rowFloats * image.height);
+  for (uint32_t y = 0; y < image.height; ++y) {
+    // Rows are stored bottom to top
+    std::memcpy(image.rgb.data() + (image.height - 1 - y) * rowFloats,
+                bytes.data() + pos + y * rowFloats * sizeof(float), rowFloats * sizeof(float));
+  }
+  return image;
+}
+
+Image readImageExr(const std::filesystem::path& path) {
+  const std::vector<char> bytes = readFile(path);
+  ByteReader reader(path, bytes);
+  if (reader.value<uint32_t>() != 20000630u || reader.value<uint32_t>() != 2u) {
+    throw std::runtime_error("Unsupported EXR (expected single-part scanline): " + path.string());
+  }
+
+  std::vector<std::string> channels;
+  bool floatChannels = true;
+  int32_t window[4] = {0, 0, -1, -1};
+  uint8_t compression = 0xff;
+  while (true) {
+    const std::string name = reader.string();
+    if (name.empty()) {
+      break;
+    }
+    reader.string();  // type
+    const int32_t size = reader.value<int32_t>();
+    if (size < 0) {
+      reader.fail();
+    }
+    const size_t end = reader.position() + static_cast<size_t>(size);
+    if (name == "channels") {
+      for (std::string channel = reader.string(); !channel.empty(); channel = reader.string()) {
+        channels.push_back(channel);
+        floatChannels &= reader.value<int32_t>() == 2;
+        reader.take(12);  // pLinear, reserved, sampling
+      }
+    } else if (name == "compression") {
+      compression = static_cast<uint8_t>(*reader.take(1));
+    } else if (name == "dataWindow") {
+      for (int32_t& v : window) {
+        v = reader.value<int32_t>();
+      }
+    }
+    reader.seek(end);
+  }
+  if (compression != 0 || !floatChannels || channels != std::vector<std::string>{"B", "G", "R"} ||
+      window[2] < window[0] || window[3] < window[1]) {
+    throw std::runtime_error("Unsupported EXR (expected uncompressed float B, G, R): " +
+                             path.string());
+  }
+
+  Image image;
+  image.width = static_cast<uint32_t>(window[2] - window[0] + 1);
+  image.height = static_cast<uint32_t>(window[3] - window[1] + 1);
+  image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+  const size_t tableOffset = reader.position();
+  for (uint32_t row = 0; row < image.height; ++row) {
+    reader.seek(tableOffset + row * sizeof(uint64_t));
+    reader.seek(reader.value<uint64_t>());
+    const int32_t y = reader.value<int32_t>() - window[1];
+    if (y < 0 || y >= static_cast<int32_t>(image.height) ||
+        reader.value<int32_t>() != static_cast<int32_t>(image.width * 3 * sizeof(float))) {
+      reader.fail();
+    }
+    float* dst = image.rgb.data() + static_cast<size_t>(y) * image.width * 3;
+    for (int channel = 2; channel >= 0; --channel) {  // B, G, R
+      for (uint32_t x = 0; x < image.width; ++x) {
+        dst[x * 3 + channel] = reader.value<float>();
+      }
+    }
+  }
+  return image;
+}
+
+std::string lowerExtension(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return ext;
+}
+
+void writeFile(const std::filesystem::path& path, const std::vector<char>& bytes) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("Failed to open image for writing: " + path.string());
+  }
+  file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    throw std::runtime_error("Failed to write image: " + path.string());
+  }
+}
+
+} // namespace
+
+void writeImagePfm(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                   std::span<const float> rgb) {
+  checkImage(path, width, height, rgb);
+
+  // A negative scale marks the payload as little-endian.
+  const std::string header =
+      "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+
+  std::vector<char> bytes(header.begin(), header.end());
+  bytes.reserve(bytes.size() + rgb.size_bytes());
+  for (uint32_t y = height; y-- > 0;) {
+    const float* row = rgb.data() + static_cast<size_t>(y) * width * 3;
+    const char* rowBytes = reinterpret_cast<const char*>(row);
+    bytes.insert(bytes.end(), rowBytes, rowBytes + sizeof(float) * width * 3);
+  }
+  writeFile(path, bytes);
+}
+
+void writeImageExr(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                   std::span<const float> rgb) {
+  checkImage(path, width, height, rgb);
+
+  constexpr int32_t kPixelTypeFloat = 2;
+  // Channels must be listed in alphabetical order; they are stored per scanline
+  // in the same order.
+  constexpr std::array<std::pair<const char*, int>, 3> kChannels = {{{"B", 2}, {"G", 1}, {"R", 0}}};
+
+  std::vector<char> bytes;
+  appendValue(bytes, static_cast<uint32_t>(20000630));  // magic
+  appendValue(bytes, static_cast<uint32_t>(2));         // version 2, single-part scanline
+
+  std::vector<char> payload;
+  for (const auto& [name, index] : kChannels) {
+    appendString(payload, name);
+    appendValue(payload, kPixelTypeFloat);
+    appendValue(payload, static_cast<uint32_t>(0));  // pLinear + 3 reserved bytes
+    appendValue(payload, static_cast<int32_t>(1));   // xSampling
+    appendValue(payload, static_cast<int32_t>(1));   // ySampling
+  }
+  payload.push_back('\0');
+  appendAttribute(bytes, "channels", "chlist", payload);
+
+  appendAttribute(bytes, "compression", "compression", {0});  // NO_COMPRESSION
+
+  payload.clear();
+  appendValue(payload, static_cast<int32_t>(0));
+  appendValue(payload, static_cast<int32_t>(0));
+  appendValue(payload, static_cast<int32_t>(width - 1));
+  appendValue(payload, static_cast<int32_t>(height - 1));
+  appendAttribute(bytes, "dataWindow", "box2i", payload);
+  appendAttribute(bytes, "displayWindow", "box2i", payload);
+
+  appendAttribute(bytes, "lineOrder", "lineOrder", {0});  // INCREASING_Y
+
+  payload.clear();
+  appendValue(payload, 1.0f);
+  appendAttribute(bytes, "pixelAspectRatio", "float", payload);
+
+  payload.clear();
+  appendValue(payload, 0.0f);
+  appendValue(payload, 0.0f);
+  appendAttribute(bytes, "screenWindowCenter", "v2f", payload);
+
+  payload.clear();
+  appendValue(payload, 1.0f);
+  appendAttribute(bytes, "screenWindowWidth", "float", payload);
+
+  bytes.push_back('\0');  // end of header
+
+  // Uncompressed files store one scanline per chunk: y, byte count, channel data.
+  const uint32_t lineBytes = width * static_cast<uint32_t>(kChannels.size()) * sizeof(float);
+  const uint64_t tableOffset = bytes.size();
+  const uint64_t firstChunk = tableOffset + sizeof(uint64_t) * height;
+  for (uint32_t y = 0; y < height; ++y) {
+    appendValue(bytes, firstChunk + static_cast<uint64_t>(y) * (8 + lineBytes));
+  }
+
+  bytes.reserve(bytes.size() + static_cast<size_t>(height) * (8 + lineBytes));
+  for (uint32_t y = 0; y < height; ++y) {
+    appendValue(bytes, static_cast<int32_t>(y));
+    appendValue(bytes, static_cast<int32_t>(lineBytes));
+    const float* row = rgb.data() + static_cast<size_t>(y) * width * 3;
+    for (const auto& [name, index] : kChannels) {
+      for (uint32_t x = 0; x < width; ++x) {
+        appendValue(bytes, row[x * 3 + index]);
+      }
+    }
+  }
+  writeFile(path, bytes);
+}
+
+void writeImage(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                std::span<const float> rgb) {
+  const std::string ext = lowerExtension(path);
+  if (ext == ".exr") {
+    writeImageExr(path, width, height, rgb);
+  } else if (ext == ".pfm") {
+    writeImagePfm(path, width, height, rgb);
+  } else {
+    throw std::runtime_error("Unsupported output image format (expected .exr or .pfm): " +
+                             path.string());
+  }
+}
+
+Image readImage(const std::filesystem::path& path) {
+  const std::string ext = lowerExtension(path);
+  if (ext == ".exr") {
+    return readImageExr(path);
+  }
+  if (ext == ".pfm") {
+    return readImagePfm(path);
+  }
+  throw std::runtime_error("Unsupported input image format (expected .exr or .pfm): " +
+                           path.string());
+}
+
+ImageDifference compareImages(std::span<const float> rgb, std::span<const float> reference) {
+  if (rgb.size() != reference.size() || rgb.empty()) {
+    throw std::runtime_error("Images to compare differ in size");
+  }
+  double sum = 0.0, referenceSum = 0.0, squared = 0.0, relative = 0.0;
+  for (size_t i = 0; i < rgb.size(); ++i) {
+    const double diff = static_cast<double>(rgb[i]) - reference[i];
+    sum += rgb[i];
+    referenceSum += reference[i];
+    squared += diff * diff;
+    relative += diff * diff / (static_cast<double>(reference[i]) * reference[i] + 0.01);
+  }
+  const double n = static_cast<double>(rgb.size());
+  return {referenceSum != 0.0 ? (sum - referenceSum) / referenceSum : 0.0, std::sqrt(squared / n),
+          relative / n};
+}
+
+}  // namespace peacock
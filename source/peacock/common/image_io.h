@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace peacock {
+
+// Linear float RGB image writers used by the offline (headless) renderer.
+// `rgb` holds width * height * 3 floats, rows ordered top to bottom.
+
+// Portable float map (little-endian, bottom-to-top rows as required by the format).
+void writeImagePfm(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                   std::span<const float> rgb);
+
+// Uncompressed single-part scanline OpenEXR with 32-bit float R, G, B channels.
+void writeImageExr(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                   std::span<const float> rgb);
+
+// Picks the writer from the file extension (.exr or .pfm).
+void writeImage(const std::filesystem::path& path, uint32_t width, uint32_t height,
+                std::span<const float> rgb);
+
+// Reads back what the writers produce: any PFM, and EXR files that are uncompressed
+// single-part scanline images with 32-bit float R, G, B channels.
+struct Image {
+  uint32_t width{0};
+  uint32_t height{0};
+  std::vector<float> rgb;
+};
+Image readImage(const std::filesystem::path& path);
+
+// Difference of an image to a reference of the same size, over all channels.
+struct ImageDifference {
+  double relativeBias{0.0};  // (sum image - sum reference) / sum reference
+  double rmse{0.0};
+  double relativeMse{0.0};   // mean of (image - reference)^2 / (reference^2 + 0.01)
+};
+ImageDifference compareImages(std::span<const float> rgb, std::span<const float> reference);
+
+}  // namespace peacock
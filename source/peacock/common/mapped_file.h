@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace peacock {
+
+// Read-only memory mapping of a whole file. Pages are faulted in lazily, so
+// copying from data() streams straight from the page cache without an
+// intermediate heap buffer. Move-only; the mapping is released on destruction.
+class MappedFile {
+public:
+  MappedFile() = default;
+  // Throws std::runtime_error if the file cannot be opened or mapped.
+  explicit MappedFile(const std::filesystem::path& path);
+  ~MappedFile();
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool isOpen() const { return m_data != nullptr; }
+
+private:
+  void release();
+
+  const uint8_t* m_data{nullptr};
+  size_t m_size{0};
+#ifdef _WIN32
+  void* m_file{nullptr};
+  void* m_mapping{nullptr};
+#endif
+};
+
+}  // namespace peacock
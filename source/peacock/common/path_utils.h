@@ -20,6 +20,8 @@ inline static std::vector<std::filesystem::path> getShaderDirs()
 {
   std::filesystem::path exePath = nvutils::getExecutablePath().parent_path();
   return {
+      std::filesystem::absolute(exePath / TARGET_EXE_TO_SOURCE_DIRECTORY / "peacock" / "shader"),
+      std::filesystem::absolute(exePath / "shader"),  // installed copy, see CMakeLists.txt
       std::filesystem::absolute(exePath / TARGET_EXE_TO_SOURCE_DIRECTORY / "shaders"),
       std::filesystem::absolute(exePath / TARGET_EXE_TO_NVSHADERS_DIRECTORY),
       std::filesystem::absolute(exePath / TARGET_EXE_TO_ROOT_DIRECTORY),
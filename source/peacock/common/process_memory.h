@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace peacock {
+
+// Peak resident set size of the current process in bytes, or 0 if unavailable.
+size_t peakResidentBytes();
+
+}  // namespace peacock
@@ -0,0 +1,510 @@
+#include "peacock/cpu/cpu_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <optional>
+
+#include <tbb/blocked_range2d.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+
+#include <nvutils/camera_manipulator.hpp>
+
+#include "peacock/common/image_io.h"
+#include "peacock/scene/camera.h"
+#include "peacock/scene/host_volume.h"
+#include "peacock/scene/volume.h"
+
+namespace peacock {
+
+namespace {
+
+// The functions below mirror the Slang modules one to one (names in comments);
+// keep them in sync when the shader integrator changes.
+
+constexpr float k2Pi = 6.28318530717958647692f;
+constexpr float kInv4Pi = 0.07957747154594766788f;
+
+// ── random.slang ──────────────────────────────────────────────────────────────
+uint32_t hashCrng(uint32_t seed) {
+  const uint32_t state = seed * 747796405u + 2891336453u;
+  const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+struct RandomSampler {
+  uint32_t state;
+
+  uint32_t nextUint() {
+    state = state * 747796405u + 1u;
+    const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+  }
+  float nextFloat() { return static_cast<float>(nextUint()) * (1.0f / 4294967296.0f); }
+  glm::vec2 nextFloat2() {
+    const float x = nextFloat();
+    return {x, nextFloat()};
+  }
+};
+
+RandomSampler initRandomSampler(glm::uvec2 pixel, uint32_t frameIndex, uint32_t sampleIndex) {
+  return {frameIndex + sampleIndex * 1000003u + hashCrng((pixel.x << 16u) | pixel.y)};
+}
+
+// ── math.slang ────────────────────────────────────────────────────────────────
+struct Ray {
+  glm::vec3 o;
+  glm::vec3 d;
+};
+
+float safeSqrt(float v) { return std::sqrt(std::max(v, 0.0f)); }
+
+std::optional<glm::vec2> rayBoxIntersect(const Ray& r, const glm::vec3& boxMin,
+                                         const glm::vec3& boxMax) {
+  const glm::vec3 invDir = 1.0f / r.d;
+  const glm::vec3 t0 = (boxMin - r.o) * invDir;
+  const glm::vec3 t1 = (boxMax - r.o) * invDir;
+  const glm::vec3 hitMin = glm::min(t0, t1);
+  const glm::vec3 hitMax = glm::max(t0, t1);
+  const float tMin = std::max(std::max(hitMin.x, hitMin.y), hitMin.z);
+  const float tMax = std::min(std::min(hitMax.x, hitMax.y), hitMax.z);
+  if (tMin < tMax && tMax > 0.0f) {
+    return glm::vec2(tMin, tMax);
+  }
+  return std::nullopt;
+}
+
+glm::vec3 frameToWorld(const glm::vec3& n, const glm::vec3& v) {
+  glm::vec3 s, t;
+  if (n.z < -0.99999f) {
+    s = {0.0f, -1.0f, 0.0f};
+    t = {-1.0f, 0.0f, 0.0f};
+  } else {
+    const float a = 1.0f / (1.0f + n.z);
+    const float b = -n.x * n.y * a;
+    s = {1.0f - n.x * n.x * a, b, -n.x};
+    t = {b, 1.0f - n.y * n.y * a, -n.y};
+  }
+  return v.x * s + v.y * t + v.z * n;
+}
+
+// ── phase/henyey_greenstein.slang ─────────────────────────────────────────────
+float hgValue(float cosTheta, float g) {
+  const float denom = 1.0f + g * g + 2.0f * g * cosTheta;
+  return kInv4Pi * (1.0f - g * g) / (denom * safeSqrt(denom));
+}
+
+struct PhaseSample {
+  glm::vec3 wi;
+  float p;
+  float pdf;
+};
+
+PhaseSample sampleHG(const glm::vec3& wo, glm::vec2 u, float g) {
+  float cosTheta;
+  if (std::abs(g) < 1e-3f) {
+    cosTheta = 1.0f - 2.0f * u.x;
+  } else {
+    const float xi = (1.0f - g * g) / (1.0f - g + 2.0f * g * u.x);
+    cosTheta = (1.0f + g * g - xi * xi) / (2.0f * g);
+  }
+  cosTheta = std::clamp(cosTheta, -1.0f, 1.0f);
+
+  const float sinTheta = safeSqrt(1.0f - cosTheta * cosTheta);
+  const float phi = k2Pi * u.y;
+  const glm::vec3 wi = frameToWorld(
+      wo, glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+  const float f = hgValue(cosTheta, g);
+  return {wi, f, f};
+}
+
+// ── volume/nanovdb.slang + medium/heterogeneous.slang ─────────────────────────
+struct Medium {
+  const nanovdb::NanoGrid<float>& grid;
+  nanovdb::NanoGrid<float>::AccessorType acc;  // per task, caches the last visited nodes
+  const shaderio::VolumeDesc& desc;
+  const MajorantGrid& majorants;
+
+  float density(const glm::vec3& p) {
+    const nanovdb::Vec3f idx = grid.worldToIndexF(nanovdb::Vec3f(p.x, p.y, p.z));
+    const nanovdb::Coord i0(static_cast<int>(std::floor(idx[0])),
+                            static_cast<int>(std::floor(idx[1])),
+                            static_cast<int>(std::floor(idx[2])));
+    const float tx = idx[0] - static_cast<float>(i0[0]);
+    const float ty = idx[1] - static_cast<float>(i0[1]);
+    const float tz = idx[2] - static_cast<float>(i0[2]);
+
+    const float c000 = acc.getValue(i0.offsetBy(0, 0, 0));
+    const float c100 = acc.getValue(i0.offsetBy(1, 0, 0));
+    const float c010 = acc.getValue(i0.offsetBy(0, 1, 0));
+    const float c110 = acc.getValue(i0.offsetBy(1, 1, 0));
+    const float c001 = acc.getValue(i0.offsetBy(0, 0, 1));
+    const float c101 = acc.getValue(i0.offsetBy(1, 0, 1));
+    const float c011 = acc.getValue(i0.offsetBy(0, 1, 1));
+    const float c111 = acc.getValue(i0.offsetBy(1, 1, 1));
+
+    const float c00 = glm::mix(c000, c100, tx);
+    const float c10 = glm::mix(c010, c110, tx);
+    const float c01 = glm::mix(c001, c101, tx);
+    const float c11 = glm::mix(c011, c111, tx);
+    const float c0 = glm::mix(c00, c10, ty);
+    const float c1 = glm::mix(c01, c11, ty);
+    return glm::mix(c0, c1, tz) * desc.densityScale;
+  }
+
+  // Extinction per unit raw density; a cell's majorant is this times its bound.
+  float sigmaT() const { return (desc.sigma_a.x + desc.sigma_s.x) * desc.densityScale; }
+};
+
+// ── medium.slang: DDAMajorantIterator ─────────────────────────────────────────
+struct MajorantSegment {
+  float sigmaMaj;
+  float tMin;
+  float tMax;
+};
+
+class DdaMajorantIterator {
+public:
+  DdaMajorantIterator(const Ray& ray, float tMin, float tMax, const Medium& medium)
+      : m_majorants(medium.majorants), m_sigmaT(medium.sigmaT()), m_tMin(tMin), m_tMax(tMax) {
+    const float cellSize = static_cast<float>(m_majorants.cellSize);
+    const nanovdb::Vec3f o = medium.grid.worldToIndexF(nanovdb::Vec3f(ray.o.x, ray.o.y, ray.o.z));
+    const nanovdb::Vec3f d =
+        medium.grid.worldToIndexDirF(nanovdb::Vec3f(ray.d.x, ray.d.y, ray.d.z));
+
+    for (int axis = 0; axis < 3; ++axis) {
+      const float oGrid = (o[axis] - m_majorants.origin[axis]) / cellSize;
+      float dGrid = d[axis] / cellSize;
+      if (dGrid == -0.0f) {
+        dGrid = 0.0f;  // -0 would pass the test below but divide to -inf
+      }
+      const float pGrid = oGrid + tMin * dGrid;
+      const int res = static_cast<int>(m_majorants.resolution[axis]);
+      m_voxel[axis] = std::clamp(static_cast<int>(std::floor(pGrid)), 0, res - 1);
+      if (dGrid >= 0.0f) {
+        m_nextCrossingT[axis] = tMin + (static_cast<float>(m_voxel[axis] + 1) - pGrid) / dGrid;
+        m_deltaT[axis] = 1.0f / dGrid;
+        m_step[axis] = 1;
+        m_voxelLimit[axis] = res;
+      } else {
+        m_nextCrossingT[axis] = tMin + (static_cast<float>(m_voxel[axis]) - pGrid) / dGrid;
+        m_deltaT[axis] = -1.0f / dGrid;
+        m_step[axis] = -1;
+        m_voxelLimit[axis] = -1;
+      }
+    }
+  }
+
+  // Next non-empty cell along the ray, or nullopt once the interval is exhausted.
+  std::optional<MajorantSegment> next() {
+    while (m_tMin < m_tMax) {
+      int axis = 0;
+      if (m_nextCrossingT.y < m_nextCrossingT[axis]) axis = 1;
+      if (m_nextCrossingT.z < m_nextCrossingT[axis]) axis = 2;
+
+      const float tCellExit = std::min(m_tMax, m_nextCrossingT[axis]);
+      const float bound = lookup(m_voxel);
+      const MajorantSegment seg{m_sigmaT * bound, m_tMin, tCellExit};
+
+      m_tMin = tCellExit;
+      if (m_nextCrossingT[axis] > m_tMax) m_tMin = m_tMax;
+      m_voxel[axis] += m_step[axis];
+      if (m_voxel[axis] == m_voxelLimit[axis]) m_tMin = m_tMax;
+      m_nextCrossingT[axis] += m_deltaT[axis];
+
+      if (bound > 0.0f && seg.tMax > seg.tMin) {
+        return seg;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  float lookup(const glm::ivec3& cell) const {
+    const glm::ivec3 res(m_majorants.resolution);
+    if (glm::any(glm::lessThan(cell, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(cell, res))) {
+      return 0.0f;
+    }
+    return m_majorants.maxDensity[(static_cast<size_t>(cell.z) * res.y + cell.y) * res.x + cell.x];
+  }
+
+  const MajorantGrid& m_majorants;
+  float m_sigmaT;
+  float m_tMin;
+  float m_tMax;
+  glm::vec3 m_nextCrossingT{0.0f};
+  glm::vec3 m_deltaT{0.0f};
+  glm::ivec3 m_step{0};
+  glm::ivec3 m_voxelLimit{0};
+  glm::ivec3 m_voxel{0};
+};
+
+// ── sampler.slang ─────────────────────────────────────────────────────────────
+std::optional<glm::vec3> sampleDistance(const Ray& ray, float tMin, float tMax, Medium& medium,
+                                        RandomSampler& rng) {
+  DdaMajorantIterator iter(ray, tMin, tMax, medium);
+  while (const auto seg = iter.next()) {
+    const float sigmaMaj = seg->sigmaMaj;
+    float t = seg->tMin;
+    while (true) {
+      t -= std::log(std::max(rng.nextFloat(), 1e-6f)) / sigmaMaj;
+      if (t >= seg->tMax) {
+        break;
+      }
+
+      const glm::vec3 pos = ray.o + t * ray.d;
+      const float density = medium.density(pos);
+      const float sigmaS = medium.desc.sigma_s.x * density;
+      const float sigmaT = medium.desc.sigma_a.x * density + sigmaS;
+
+      const float u = rng.nextFloat();
+      if (u < sigmaS / sigmaMaj) {
+        return pos;  // real scatter event
+      }
+      if (u < sigmaT / sigmaMaj) {
+        return std::nullopt;  // absorbed
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+glm::vec3 evalTransmittance(const Ray& ray, float tMin, float tMax, Medium& medium,
+                            RandomSampler& rng) {
+  glm::vec3 tr(1.0f);
+  DdaMajorantIterator iter(ray, tMin, tMax, medium);
+  while (const auto seg = iter.next()) {
+    const float sigmaMaj = seg->sigmaMaj;
+    float t = seg->tMin;
+    while (true) {
+      t -= std::log(std::max(rng.nextFloat(), 1e-6f)) / sigmaMaj;
+      if (t >= seg->tMax) {
+        break;
+      }
+
+      const float density = medium.density(ray.o + t * ray.d);
+      const float sigmaT = (medium.desc.sigma_a.x + medium.desc.sigma_s.x) * density;
+      tr *= std::max(sigmaMaj - sigmaT, 0.0f) / sigmaMaj;
+
+      const float maxTr = std::max(tr.x, std::max(tr.y, tr.z));
+      if (maxTr < 0.01f) {
+        const float q = std::max(0.05f, 1.0f - maxTr);
+        if (rng.nextFloat() < q) {
+          return glm::vec3(0.0f);
+        }
+        tr /= (1.0f - q);
+      }
+    }
+  }
+  return tr;
+}
+
+// ── renderer.slang ────────────────────────────────────────────────────────────
+float evalMISWeight(float pA, float pB) {
+  const float qA = pA * pA;
+  const float qB = pB * pB;
+  return qA / std::max(qA + qB, 1e-8f);
+}
+
+struct Integrator {
+  const shaderio::SceneInfo& scene;
+  const shaderio::VolumeDesc& desc;
+  const EnvironmentMap& env;
+  glm::uvec2 resolution;
+
+  glm::vec3 evalNEE(const glm::vec3& pos, const glm::vec3& wo, Medium& medium,
+                    RandomSampler& rng) const {
+    // light::EnvironmentLight::sample — luminance-weighted texel CDFs
+    float pLight = 0.0f;
+    const glm::vec3 wi = env.sampleDirection(rng.nextFloat2(), pLight);
+    const glm::vec3 Le = env.eval(wi);
+
+    const float fPhase = hgValue(glm::dot(wo, wi), desc.g);
+    const float pPhase = fPhase;
+
+    glm::vec3 tr(1.0f);
+    const Ray shadowRay{pos, wi};
+    if (auto hit = rayBoxIntersect(shadowRay, desc.bboxMin, desc.bboxMax)) {
+      const float t0 = std::max(hit->x, 1e-4f);
+      const float t1 = hit->y;
+      if (t1 > t0) {
+        tr = evalTransmittance(shadowRay, t0, t1, medium, rng);
+      }
+    }
+
+    const float wMIS = evalMISWeight(pLight, pPhase);
+    return fPhase * Le * tr * (wMIS / std::max(pLight, 1e-8f));
+  }
+
+  Ray cameraRay(glm::uvec2 pixel, RandomSampler& rng) const {
+    // Film::sample + Camera::sample_ray
+    const glm::vec2 jittered = glm::vec2(pixel) + rng.nextFloat2();
+    const glm::vec2 clip = jittered / glm::vec2(resolution) * 2.0f - 1.0f;
+    const glm::vec4 viewCoords = scene.projInvMatrix * glm::vec4(clip, 1.0f, 1.0f);
+    const glm::vec3 origin = glm::vec3(scene.viewInvMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    const glm::vec3 dir =
+        glm::vec3(scene.viewInvMatrix * glm::vec4(glm::normalize(glm::vec3(viewCoords)), 0.0f));
+    return {origin, dir};
+  }
+
+  glm::vec3 traceVolumePath(glm::uvec2 pixel, Medium& medium, RandomSampler& rng) const {
+    Ray ray = cameraRay(pixel, rng);
+
+    glm::vec3 L(0.0f);
+    glm::vec3 thp(1.0f);
+    float prevPhasePdf = 0.0f;
+
+    for (int depth = 0; depth < scene.maxScatterDepth; ++depth) {
+      const auto boxHit = rayBoxIntersect(ray, desc.bboxMin, desc.bboxMax);
+      std::optional<glm::vec3> scatterPos;
+      if (boxHit) {
+        const float tNear = std::max(boxHit->x, 0.0f);
+        scatterPos = sampleDistance(ray, tNear, boxHit->y, medium, rng);
+      }
+
+      // Miss or transmitted through the volume: environment with MIS weight.
+      if (!scatterPos) {
+        glm::vec3 Le = env.eval(ray.d);
+        if (prevPhasePdf > 0.0f) {
+          Le *= evalMISWeight(prevPhasePdf, env.pdf(ray.d));
+        }
+        L += thp * Le;
+        break;
+      }
+
+      L += thp * evalNEE(*scatterPos, ray.d, medium, rng);
+
+      const PhaseSample scatter = sampleHG(ray.d, rng.nextFloat2(), desc.g);
+      thp *= scatter.p / std::max(scatter.pdf, 1e-8f);
+      prevPhasePdf = scatter.pdf;
+
+      if (depth >= scene.russianRouletteDepth) {
+        const float q = std::clamp(std::max(thp.r, std::max(thp.g, thp.b)), 0.0f, 1.0f);
+        if (rng.nextFloat() > q) {
+          break;
+        }
+        thp /= std::max(q, 1e-3f);
+      }
+
+      ray = {*scatterPos, scatter.wi};
+    }
+    return L;
+  }
+};
+
+} // namespace
+
+CpuRenderer::CpuRenderer(const nanovdb::NanoGrid<float>& grid,
+                         const shaderio::VolumeDesc& volumeDesc,
+                         const MajorantGrid& majorants, const EnvironmentMap& environment)
+    : m_grid(grid), m_volumeDesc(volumeDesc), m_majorants(majorants), m_environment(environment) {}
+
+CpuRenderer::Stats CpuRenderer::render(const shaderio::SceneInfo& sceneInfo, uint32_t width,
+                                       uint32_t height, uint32_t frameCount, uint32_t tileSize,
+                                       std::vector<float>& rgb) const {
+  rgb.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+  tileSize = std::max(tileSize, 1u);
+  const uint32_t tilesX = (width + tileSize - 1) / tileSize;
+  const uint32_t tilesY = (height + tileSize - 1) / tileSize;
+  const uint32_t spp = std::max(sceneInfo.sampleCount, 1u);
+
+  const Integrator integrator{sceneInfo, m_volumeDesc, m_environment, {width, height}};
+
+  const auto start = std::chrono::steady_clock::now();
+  tbb::parallel_for(
+      tbb::blocked_range2d<uint32_t>(0, tilesY, 1, 0, tilesX, 1),
+      [&](const tbb::blocked_range2d<uint32_t>& tiles) {
+        Medium medium{m_grid, m_grid.getAccessor(), m_volumeDesc, m_majorants};
+        for (uint32_t ty = tiles.rows().begin(); ty != tiles.rows().end(); ++ty) {
+          for (uint32_t tx = tiles.cols().begin(); tx != tiles.cols().end(); ++tx) {
+            const uint32_t x1 = std::min((tx + 1) * tileSize, width);
+            const uint32_t y1 = std::min((ty + 1) * tileSize, height);
+            for (uint32_t y = ty * tileSize; y < y1; ++y) {
+              for (uint32_t x = tx * tileSize; x < x1; ++x) {
+                glm::vec3 mean(0.0f);
+                for (uint32_t frame = 1; frame <= frameCount; ++frame) {
+                  glm::vec3 sum(0.0f);
+                  for (uint32_t s = 0; s < spp; ++s) {
+                    RandomSampler rng = initRandomSampler({x, y}, frame, s);
+                    sum += integrator.traceVolumePath({x, y}, medium, rng);
+                  }
+                  // renderer.slang `accumulate`
+                  const glm::vec3 sample = sum / static_cast<float>(spp);
+                  mean = frame <= 1 ? sample : glm::mix(mean, sample, 1.0f / frame);
+                }
+                float* out = rgb.data() + (static_cast<size_t>(y) * width + x) * 3;
+                out[0] = mean.r;
+                out[1] = mean.g;
+                out[2] = mean.b;
+              }
+            }
+          }
+        }
+      });
+
+  Stats stats;
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.samples = static_cast<uint64_t>(width) * height * frameCount * spp;
+  return stats;
+}
+
+void renderOnCpu(const RaytracerSettings& settings, uint32_t width, uint32_t height) {
+  std::unique_ptr<tbb::global_control> threadLimit;
+  if (settings.cpuThreads > 0) {
+    threadLimit = std::make_unique<tbb::global_control>(
+        tbb::global_control::max_allowed_parallelism, settings.cpuThreads);
+  }
+
+  // The CPU integrator reads voxels through NanoGrid<float> accessors only.
+  VolumeLoadOptions loadOptions = VolumeLoadOptions::fromSettings(settings);
+  if (loadOptions.precision != VolumePrecision::eFloat) {
+    printf("[CPU] --volume-precision %s is GPU-only, using float\n",
+           volumePrecisionName(loadOptions.precision));
+    loadOptions.precision = VolumePrecision::eFloat;
+  }
+  const HostVolume volume = HostVolume::load(settings.volumePath, loadOptions);
+  const nanovdb::NanoGrid<float>& grid = *volume.grid<float>();
+  shaderio::VolumeDesc volumeDesc = makeVolumeDesc(grid);
+  const MajorantGrid majorants = MajorantGrid::build(grid, settings.majorantCellSize);
+  majorants.describe(volumeDesc);
+  const EnvironmentMap environment = EnvironmentMap::load(settings.hdrPath);
+  if (glm::dot(settings.sunRadiance, settings.sunRadiance) > 0.0f) {
+    printf("[CPU] --sun-radiance is GPU-only, lighting with the environment alone\n");
+  }
+
+  auto camera = std::make_shared<nvutils::CameraManipulator>();
+  camera->setWindowSize({width, height});
+  if (settings.hasCamera()) {
+    camera->setFov(settings.fov);
+    camera->setLookat(settings.eye, settings.center, settings.up);
+  } else {
+    setupCameraForBox(camera, volumeDesc.bboxMin, volumeDesc.bboxMax,
+                      static_cast<float>(width) / static_cast<float>(height));
+  }
+
+  shaderio::SceneInfo sceneInfo{};
+  sceneInfo.viewProjMatrix = camera->getPerspectiveMatrix() * camera->getViewMatrix();
+  sceneInfo.projInvMatrix = glm::inverse(camera->getPerspectiveMatrix());
+  sceneInfo.viewInvMatrix = glm::inverse(camera->getViewMatrix());
+  sceneInfo.cameraPosition = camera->getEye();
+  sceneInfo.sampleCount = settings.sppPerDispatch;
+
+  std::vector<float> rgb;
+  const CpuRenderer renderer(grid, volumeDesc, majorants, environment);
+  const CpuRenderer::Stats stats = renderer.render(sceneInfo, width, height,
+                                                   settings.dispatchCount(),
+                                                   settings.cpuTileSize, rgb);
+
+  printf("[CPU] %ux%u, %u spp on %zu threads: %.3f s, %.2f Msamples/s\n", width, height,
+         settings.dispatchCount() * settings.sppPerDispatch,
+         tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism),
+         stats.seconds, stats.samplesPerSecond() * 1e-6);
+
+  writeImage(settings.outputPath, width, height, rgb);
+  printf("[CPU] wrote %s\n", settings.outputPath.string().c_str());
+}
+
+}  // namespace peacock
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <nanovdb/NanoVDB.h>
+
+#include "peacock/render_settings.h"
+#include "peacock/scene/environment.h"
+#include "peacock/scene/majorant_grid.h"
+#include "peacock/shaderio.h"
+
+namespace peacock {
+
+// CPU port of the volume path tracer in renderer.slang (delta tracking over the
+// majorant-grid DDA, ratio-tracked environment NEE with MIS, HG phase sampling,
+// Russian roulette). It consumes the same SceneInfo/VolumeDesc as the GPU and reproduces the per-pixel random streams of
+// random::init_random_sampler, so its output is a reference for validating the GPU path.
+//
+// The image is split into tiles that are scheduled across all cores by TBB's
+// work-stealing scheduler; each task owns its own NanoVDB ReadAccessor.
+class CpuRenderer {
+public:
+  struct Stats {
+    uint64_t samples{0};
+    double seconds{0.0};
+
+    double samplesPerSecond() const { return seconds > 0.0 ? samples / seconds : 0.0; }
+  };
+
+  CpuRenderer(const nanovdb::NanoGrid<float>& grid, const shaderio::VolumeDesc& volumeDesc,
+              const MajorantGrid& majorants, const EnvironmentMap& environment);
+
+  // Renders frames 1..frameCount with sceneInfo.sampleCount samples per pixel each,
+  // accumulating the running mean like renderer.slang's `accumulate`.
+  // `rgb` receives width * height * 3 floats, rows top to bottom.
+  Stats render(const shaderio::SceneInfo& sceneInfo, uint32_t width, uint32_t height,
+               uint32_t frameCount, uint32_t tileSize, std::vector<float>& rgb) const;
+
+private:
+  const nanovdb::NanoGrid<float>& m_grid;
+  shaderio::VolumeDesc m_volumeDesc;
+  const MajorantGrid& m_majorants;
+  const EnvironmentMap& m_environment;
+};
+
+// Entry point of the --cpu backend: loads the scene, renders settings.targetSpp samples
+// per pixel without any Vulkan device and writes settings.outputPath.
+void renderOnCpu(const RaytracerSettings& settings, uint32_t width, uint32_t height);
+
+}  // namespace peacock
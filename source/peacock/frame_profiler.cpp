@@ -0,0 +1,220 @@
+#include "peacock/frame_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <nvvk/check_error.hpp>
+
+namespace peacock {
+
+void FrameProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                         uint32_t maxScopesPerFrame) {
+  m_device = device;
+  m_maxScopes = std::max(maxScopesPerFrame, 1u);
+  m_queriesPerFrame = eSectionCount * m_maxScopes * 2;
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &props);
+  m_timestampPeriodNs = props.limits.timestampPeriod;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  const uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+  m_enabled = validBits > 0 && m_timestampPeriodNs > 0.0;
+  if (!m_enabled) {
+    printf("[Profiler] timestamps not supported on queue family %u\n", queueFamily);
+    return;
+  }
+  m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  const VkQueryPoolCreateInfo poolInfo{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = m_queriesPerFrame,
+  };
+  for (PendingFrame& pending : m_ring) {
+    NVVK_CHECK(vkCreateQueryPool(m_device, &poolInfo, nullptr, &pending.pool));
+  }
+}
+
+void FrameProfiler::deinit() {
+  stopCsv();
+  for (PendingFrame& pending : m_ring) {
+    if (pending.pool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(m_device, pending.pool, nullptr);
+    }
+    pending = {};
+  }
+  m_history.clear();
+  m_enabled = false;
+}
+
+void FrameProfiler::beginFrame(VkCommandBuffer cmd, const FrameInfo& info) {
+  if (!m_enabled) {
+    return;
+  }
+  m_current = (m_current + 1) % kRingSize;
+  PendingFrame& pending = m_ring[m_current];
+  if (pending.recorded && !resolve(pending, false)) {
+    ++m_dropped;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  pending.recorded = true;
+  pending.frame = m_frameCounter++;
+  pending.info = info;
+  pending.wallMs = m_lastBegin == std::chrono::steady_clock::time_point{}
+                       ? 0.0
+                       : std::chrono::duration<double, std::milli>(now - m_lastBegin).count();
+  pending.scopes = {};
+  m_lastBegin = now;
+
+  vkCmdResetQueryPool(cmd, pending.pool, 0, m_queriesPerFrame);
+}
+
+void FrameProfiler::updateFrameInfo(const FrameInfo& info) {
+  PendingFrame& pending = m_ring[m_current];
+  if (m_enabled && pending.recorded) {
+    pending.info = info;
+  }
+}
+
+void FrameProfiler::begin(VkCommandBuffer cmd, Section section) {
+  PendingFrame& pending = m_ring[m_current];
+  if (!m_enabled || !pending.recorded || pending.scopes[section] >= m_maxScopes) {
+    return;
+  }
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, pending.pool,
+                       queryIndex(section, pending.scopes[section], false));
+}
+
+void FrameProfiler::end(VkCommandBuffer cmd, Section section) {
+  PendingFrame& pending = m_ring[m_current];
+  if (!m_enabled || !pending.recorded || pending.scopes[section] >= m_maxScopes) {
+    return;
+  }
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, pending.pool,
+                       queryIndex(section, pending.scopes[section], true));
+  ++pending.scopes[section];
+}
+
+void FrameProfiler::flush() {
+  if (!m_enabled) {
+    return;
+  }
+  // Oldest first, so the history stays in frame order.
+  for (size_t i = 1; i <= kRingSize; ++i) {
+    PendingFrame& pending = m_ring[(m_current + i) % kRingSize];
+    if (pending.recorded) {
+      resolve(pending, true);
+    }
+  }
+}
+
+bool FrameProfiler::resolve(PendingFrame& pending, bool wait) {
+  pending.recorded = false;
+
+  std::array<double, eSectionCount> ms{};
+  for (uint32_t section = 0; section < eSectionCount; ++section) {
+    // Only written pairs are queried: waiting on a query that was reset but never
+    // written would never return.
+    for (uint32_t scope = 0; scope < pending.scopes[section]; ++scope) {
+      std::array<uint64_t, 4> data{};  // begin, availability, end, availability
+      const VkResult result = vkGetQueryPoolResults(
+          m_device, pending.pool, queryIndex(static_cast<Section>(section), scope, false), 2,
+          sizeof(data), data.data(), 2 * sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT |
+              (wait ? VK_QUERY_RESULT_WAIT_BIT : 0));
+      if ((result != VK_SUCCESS && result != VK_NOT_READY) || data[1] == 0 || data[3] == 0) {
+        return false;
+      }
+      const uint64_t ticks = (data[2] - data[0]) & m_timestampMask;
+      ms[section] += static_cast<double>(ticks) * m_timestampPeriodNs * 1e-6;
+    }
+  }
+
+  FrameStats stats{};
+  stats.frame = pending.frame;
+  stats.info = pending.info;
+  stats.sceneUpdateMs = ms[eSceneUpdate];
+  stats.traceMs = ms[eTraceRays];
+  stats.wallMs = pending.wallMs;
+  const double samples = static_cast<double>(pending.info.width) * pending.info.height *
+                         pending.info.samplesPerPixel;
+  stats.pathsPerSecond = stats.traceMs > 0.0 ? samples / (stats.traceMs * 1e-3) : 0.0;
+  stats.samplesPerSecond = stats.wallMs > 0.0 ? samples / (stats.wallMs * 1e-3) : 0.0;
+
+  m_totals.frames += 1;
+  m_totals.sceneUpdateMs += stats.sceneUpdateMs;
+  m_totals.traceMs += stats.traceMs;
+  m_totals.samples += samples;
+  Totals& variant = m_variantTotals[stats.info.variant];
+  variant.frames += 1;
+  variant.sceneUpdateMs += stats.sceneUpdateMs;
+  variant.traceMs += stats.traceMs;
+  variant.samples += samples;
+
+  m_history.push_back(stats);
+  while (m_history.size() > kHistorySize) {
+    m_history.pop_front();
+  }
+
+  if (m_csv.is_open()) {
+    m_csv << stats.frame << ',' << stats.info.width << ',' << stats.info.height << ','
+          << stats.info.samplesPerPixel << ',' << stats.info.maxScatterDepth << ','
+          << stats.info.densityScale << ',' << stats.info.accumulatedFrames << ','
+          << stats.info.backend << ',' << stats.info.variant << ','
+          << stats.sceneUpdateMs << ',' << stats.traceMs << ',' << stats.wallMs << ','
+          << stats.pathsPerSecond << ',' << stats.samplesPerSecond << '\n';
+  }
+  return true;
+}
+
+FrameProfiler::Summary FrameProfiler::summary() const {
+  Summary summary{};
+  if (m_history.empty()) {
+    return summary;
+  }
+  summary.frames = m_history.size();
+  summary.traceMsMin = m_history.front().traceMs;
+  summary.traceMsMax = m_history.front().traceMs;
+  for (const FrameStats& stats : m_history) {
+    summary.traceMsMean += stats.traceMs;
+    summary.traceMsMin = std::min(summary.traceMsMin, stats.traceMs);
+    summary.traceMsMax = std::max(summary.traceMsMax, stats.traceMs);
+    summary.sceneUpdateMsMean += stats.sceneUpdateMs;
+    summary.pathsPerSecondMean += stats.pathsPerSecond;
+    summary.samplesPerSecondMean += stats.samplesPerSecond;
+  }
+  const double n = static_cast<double>(summary.frames);
+  summary.traceMsMean /= n;
+  summary.sceneUpdateMsMean /= n;
+  summary.pathsPerSecondMean /= n;
+  summary.samplesPerSecondMean /= n;
+  return summary;
+}
+
+bool FrameProfiler::startCsv(const std::filesystem::path& path) {
+  stopCsv();
+  m_csv.open(path, std::ios::trunc);
+  if (!m_csv) {
+    printf("[Profiler] failed to open %s\n", path.string().c_str());
+    return false;
+  }
+  m_csvPath = path;
+  m_csv << "frame,width,height,spp,max_depth,density_scale,accumulated_frames,backend,variant,"
+           "scene_update_ms,trace_ms,wall_ms,paths_per_s,samples_per_s\n";
+  printf("[Profiler] streaming frame stats to %s\n", path.string().c_str());
+  return true;
+}
+
+void FrameProfiler::stopCsv() {
+  if (m_csv.is_open()) {
+    m_csv.close();
+  }
+}
+
+}  // namespace peacock
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+#include <vulkan/vulkan_core.h>
+
+namespace peacock {
+
+// GPU timestamps around the per-frame scene update and trace dispatches, read back
+// without ever waiting on the device.
+//
+// Every rendered frame takes the next query pool of a small ring. Before a pool is
+// reused its results are fetched with VK_QUERY_RESULT_WITH_AVAILABILITY_BIT and no
+// WAIT flag; the ring is deeper than the frames in flight, so they are normally
+// available, and a frame whose queries are not is dropped rather than waited for.
+// Resolved frames feed a rolling history and, optionally, a CSV stream.
+class FrameProfiler {
+public:
+  enum Section { eSceneUpdate, eTraceRays, eSectionCount };
+
+  // What the frame rendered, recorded with it so throughput can be derived once the
+  // timestamps resolve, and so CSV rows can be compared across settings.
+  struct FrameInfo {
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t samplesPerPixel{0};  // summed over all dispatches of the frame
+    uint32_t maxScatterDepth{0};
+    float densityScale{0.0f};
+    uint32_t accumulatedFrames{0};
+    const char* backend{""};  // static string naming the dispatch path
+    uint32_t variant{0};      // caller-defined id of the pipeline variant that ran
+  };
+
+  struct FrameStats {
+    uint64_t frame{0};
+    FrameInfo info;
+    double sceneUpdateMs{0.0};
+    double traceMs{0.0};
+    double wallMs{0.0};          // host time since the previous frame began
+    double pathsPerSecond{0.0};  // traced paths (one per pixel sample) / GPU trace time
+    double samplesPerSecond{0.0};  // accumulated pixel samples / wall time
+  };
+
+  struct Summary {
+    double traceMsMean{0.0};
+    double traceMsMin{0.0};
+    double traceMsMax{0.0};
+    double sceneUpdateMsMean{0.0};
+    double pathsPerSecondMean{0.0};
+    double samplesPerSecondMean{0.0};
+    size_t frames{0};
+  };
+
+  // Over every resolved frame, not just the history window.
+  struct Totals {
+    uint64_t frames{0};
+    double sceneUpdateMs{0.0};
+    double traceMs{0.0};
+    double samples{0.0};
+  };
+
+  // `maxScopesPerFrame` bounds how often a section may be timed within one frame
+  // (the offline path records several dispatches per frame).
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+            uint32_t maxScopesPerFrame = 1);
+  void deinit();
+  bool enabled() const { return m_enabled; }
+
+  // Starts a new frame: resolves the oldest pool of the ring and resets it on `cmd`.
+  void beginFrame(VkCommandBuffer cmd, const FrameInfo& info);
+  // Replaces the info of the frame being recorded, for what is decided after beginFrame.
+  void updateFrameInfo(const FrameInfo& info);
+  void begin(VkCommandBuffer cmd, Section section);
+  void end(VkCommandBuffer cmd, Section section);
+
+  // Resolves every pending frame, waiting for the device; only for shutdown or the
+  // end of an offline render.
+  void flush();
+
+  const std::deque<FrameStats>& history() const { return m_history; }
+  Summary summary() const;
+  const Totals& totals() const { return m_totals; }
+  const std::map<uint32_t, Totals>& variantTotals() const { return m_variantTotals; }
+  uint64_t droppedFrames() const { return m_dropped; }
+
+  bool startCsv(const std::filesystem::path& path);
+  void stopCsv();
+  bool csvActive() const { return m_csv.is_open(); }
+  const std::filesystem::path& csvPath() const { return m_csvPath; }
+
+  static constexpr size_t kHistorySize = 240;
+
+private:
+  static constexpr size_t kRingSize = 4;
+
+  struct PendingFrame {
+    VkQueryPool pool{VK_NULL_HANDLE};
+    bool recorded{false};
+    uint64_t frame{0};
+    FrameInfo info;
+    double wallMs{0.0};
+    std::array<uint32_t, eSectionCount> scopes{};  // begin/end pairs written per section
+  };
+
+  uint32_t queryIndex(Section section, uint32_t scope, bool isEnd) const {
+    return (section * m_maxScopes + scope) * 2 + (isEnd ? 1 : 0);
+  }
+  bool resolve(PendingFrame& pending, bool wait);
+
+  VkDevice m_device{VK_NULL_HANDLE};
+  bool m_enabled{false};
+  double m_timestampPeriodNs{1.0};
+  uint64_t m_timestampMask{~0ull};
+  uint32_t m_maxScopes{1};
+  uint32_t m_queriesPerFrame{0};
+
+  std::array<PendingFrame, kRingSize> m_ring{};
+  size_t m_current{0};
+  uint64_t m_frameCounter{0};
+  uint64_t m_dropped{0};
+  std::chrono::steady_clock::time_point m_lastBegin{};
+
+  Totals m_totals;
+  std::map<uint32_t, Totals> m_variantTotals;  // keyed by FrameInfo::variant
+  std::deque<FrameStats> m_history;
+  std::ofstream m_csv;
+  std::filesystem::path m_csvPath;
+};
+
+}  // namespace peacock
@@ -0,0 +1,130 @@
+#include "peacock/pipeline_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <nvvk/check_error.hpp>
+
+namespace peacock {
+
+namespace {
+
+std::vector<char> readFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return {};
+  }
+  std::vector<char> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+    return {};
+  }
+  return data;
+}
+
+size_t hashData(const std::vector<char>& data) {
+  return std::hash<std::string_view>{}(std::string_view(data.data(), data.size()));
+}
+
+bool matchesDevice(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties) {
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+         std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+}  // namespace
+
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physicalDevice,
+                         const std::filesystem::path& path) {
+  m_device = device;
+  m_path = path;
+  vkGetPhysicalDeviceProperties(physicalDevice, &m_properties);
+
+  std::vector<char> data = readFile(m_path);
+  if (!data.empty() && !matchesDevice(data, m_properties)) {
+    printf("[PipelineCache] %s was written for another device or driver, rebuilding\n",
+           m_path.string().c_str());
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = data.size(),
+      .pInitialData = data.empty() ? nullptr : data.data(),
+  };
+  if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_cache) != VK_SUCCESS) {
+    // The header matched but the driver still refused the contents
+    printf("[PipelineCache] %s rejected by the driver, rebuilding\n", m_path.string().c_str());
+    data.clear();
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    NVVK_CHECK(vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_cache));
+  }
+  m_savedHash = hashData(data);
+  if (!data.empty()) {
+    printf("[PipelineCache] loaded %.1f KB from %s\n", data.size() / 1024.0,
+           m_path.string().c_str());
+  }
+}
+
+void PipelineCache::deinit() {
+  if (m_cache == VK_NULL_HANDLE) {
+    return;
+  }
+  save();
+  vkDestroyPipelineCache(m_device, m_cache, nullptr);
+  m_cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save() {
+  if (m_cache == VK_NULL_HANDLE) {
+    return false;
+  }
+  size_t size = 0;
+  if (vkGetPipelineCacheData(m_device, m_cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+    return false;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(m_device, m_cache, &size, data.data()) != VK_SUCCESS) {
+    return false;
+  }
+  data.resize(size);
+  const size_t hash = hashData(data);
+  if (hash == m_savedHash) {
+    return true;
+  }
+
+  std::filesystem::path temporary = m_path;
+  temporary += ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+      printf("[PipelineCache] failed to write %s\n", temporary.string().c_str());
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, m_path, error);
+  if (error) {
+    printf("[PipelineCache] failed to replace %s: %s\n", m_path.string().c_str(),
+           error.message().c_str());
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  m_savedHash = hash;
+  printf("[PipelineCache] saved %.1f KB to %s\n", data.size() / 1024.0, m_path.string().c_str());
+  return true;
+}
+
+}  // namespace peacock
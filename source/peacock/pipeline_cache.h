@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+#include <vulkan/vulkan_core.h>
+
+namespace peacock {
+
+// VkPipelineCache persisted to disk between runs.
+//
+// The file holds the raw vkGetPipelineCacheData blob. It is only handed to the driver
+// when its header names this device and driver (vendor, device, pipelineCacheUUID);
+// anything else is discarded and rebuilt. Saving goes through a temporary file and a
+// rename, so an interrupted write never leaves a truncated cache behind, and is skipped
+// when the driver has nothing new to add.
+class PipelineCache {
+public:
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const std::filesystem::path& path);
+  // Saves, then destroys the cache.
+  void deinit();
+
+  bool save();
+
+  VkPipelineCache handle() const { return m_cache; }
+
+private:
+  VkDevice m_device{VK_NULL_HANDLE};
+  VkPipelineCache m_cache{VK_NULL_HANDLE};
+  VkPhysicalDeviceProperties m_properties{};
+  std::filesystem::path m_path;
+  size_t m_savedHash{0};  // of the data last loaded or written
+};
+
+}  // namespace peacock
@@ -8,21 +8,20 @@
     printf("\n");                                                              \
   }
 
-#define STB_IMAGE_IMPLEMENTATION
-
-
 #include "peacock/raytracer.h"
 
 #include <algorithm>
 #include <array>
 #include <bit>
 #include <cmath>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
 
-#include <openvdb/openvdb.h>
 #include <nanovdb/NanoVDB.h>
-#include <nanovdb/tools/CreateNanoGrid.h>
-#include <stb/stb_image.h>
 
 #include <nvvk/check_error.hpp>
 #include <nvvk/debug_util.hpp>
@@ -30,105 +29,245 @@
 #include <nvgui/camera.hpp>
 
 #include "peacock/_autogen/renderer.slang.h"
+#include "peacock/_autogen/renderer_compute.slang.h"
+#include "peacock/_autogen/renderer_compute_rayquery.slang.h"
+#include "peacock/_autogen/renderer_rayquery.slang.h"
+#include "peacock/common/image_io.h"
 #include "peacock/common/path_utils.h"
+#include "peacock/common/process_memory.h"
+#include "peacock/scene/camera.h"
+#include "peacock/scene/density_pyramid.h"
+#include "peacock/scene/volume.h"
 
 using namespace peacock;
 
 namespace {
 
-void setupCameraForBox(const std::shared_ptr<nvutils::CameraManipulator>& camera,
-                       const glm::vec3& boxMin,
-                       const glm::vec3& boxMax,
-                       float aspect) {
-  const glm::vec3 center = (boxMin + boxMax) * 0.5f;
-  const glm::vec3 halfExtent = (boxMax - boxMin) * 0.5f;
+// Orders back-to-back accumulation dispatches: each one reads the running mean
+// written by the previous one, and the final one is read by the readback copy.
+void cmdAccumulationBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 traceStages) {
+  const VkMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = traceStages,
+      .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .dstStageMask = traceStages |
+                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                       VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_READ_BIT,
+  };
+  const VkDependencyInfo depInfo{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(cmd, &depInfo);
+}
 
-  const float safeAspect = std::max(aspect, 0.1f);
-  const float tanHalfFovY = std::tan(0.5f * glm::radians(camera->getFov()));
-  const float tanHalfFovX = tanHalfFovY * safeAspect;
+// Between wavefront stages: the next stage reads the path state and queues written
+// by the previous one, and its indirect arguments come from wfPrepare.
+void cmdWavefrontBarrier(VkCommandBuffer cmd) {
+  const VkMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                       VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                       VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+  };
+  const VkDependencyInfo depInfo{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(cmd, &depInfo);
+}
 
-  const float distX = halfExtent.x / std::max(tanHalfFovX, 1e-4f);
-  const float distY = halfExtent.y / std::max(tanHalfFovY, 1e-4f);
-  const float margin = 1.15f;
-  const float distance = std::max(distX, distY) * margin + halfExtent.z;
+// Pixels covered by one compute workgroup along each axis, see compMain in renderer_compute.slang.
+constexpr uint32_t kComputeTileSize = 8;
 
-  const glm::vec3 eye = center + glm::vec3(0.0f, 0.0f, distance);
-  camera->setLookat(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+// NanoVDB grids are 32-byte aligned; packed grids keep that alignment.
+constexpr VkDeviceSize kGridAlignment = 32;
+
+VkTransformMatrixKHR toTransformMatrixKHR(const glm::mat4 &matrix) {
+  VkTransformMatrixKHR transform{};
+  for (int row = 0; row < 3; ++row) {
+    for (int column = 0; column < 4; ++column) {
+      transform.matrix[row][column] = matrix[column][row];
+    }
+  }
+  return transform;
 }
 
-glm::mat4 makeWorldToIndexMatrix(const nanovdb::Map& map) {
-  const float tx = -(map.mVecF[0] * map.mInvMatF[0] + map.mVecF[1] * map.mInvMatF[3] +
-                     map.mVecF[2] * map.mInvMatF[6]);
-  const float ty = -(map.mVecF[0] * map.mInvMatF[1] + map.mVecF[1] * map.mInvMatF[4] +
-                     map.mVecF[2] * map.mInvMatF[7]);
-  const float tz = -(map.mVecF[0] * map.mInvMatF[2] + map.mVecF[1] * map.mInvMatF[5] +
-                     map.mVecF[2] * map.mInvMatF[8]);
+// Stages and groups of the single-raygen ray tracing pipeline. `info` points into the
+// object, so it stays put; the SBT generator only reads the groups, so it is also
+// built without code for sizing the table.
+struct RayTracingPipelineDesc {
+  RayTracingPipelineDesc(const VkShaderModuleCreateInfo *shaderCode, VkPipelineLayout layout,
+                         const VkSpecializationInfo *specialization = nullptr) {
+    stage = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .pNext = shaderCode,
+        .stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+        .pName = "rgenMain",
+        .pSpecializationInfo = specialization,
+    };
+    group = {
+        .sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+        .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
+        .generalShader = 0,
+        .closestHitShader = VK_SHADER_UNUSED_KHR,
+        .anyHitShader = VK_SHADER_UNUSED_KHR,
+        .intersectionShader = VK_SHADER_UNUSED_KHR,
+    };
+    info = {
+        .sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR,
+        .stageCount = 1,
+        .pStages = &stage,
+        .groupCount = 1,
+        .pGroups = &group,
+        .maxPipelineRayRecursionDepth = 1,
+        .layout = layout,
+    };
+  }
+  RayTracingPipelineDesc(const RayTracingPipelineDesc &) = delete;
+  RayTracingPipelineDesc &operator=(const RayTracingPipelineDesc &) = delete;
+
+  VkPipelineShaderStageCreateInfo stage{};
+  VkRayTracingShaderGroupCreateInfoKHR group{};
+  VkRayTracingPipelineCreateInfoKHR info{};
+};
+
+VkShaderModuleCreateInfo shaderModuleInfo(const std::vector<uint32_t> &spirv) {
+  return {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = spirv.size() * sizeof(uint32_t),
+      .pCode = spirv.data(),
+  };
+}
 
-  return glm::mat4(
-      map.mInvMatF[0], map.mInvMatF[3], map.mInvMatF[6], 0.0f,
-      map.mInvMatF[1], map.mInvMatF[4], map.mInvMatF[7], 0.0f,
-      map.mInvMatF[2], map.mInvMatF[5], map.mInvMatF[8], 0.0f,
-      tx, ty, tz, 1.0f);
+std::vector<uint32_t> embeddedSpirv(const uint32_t *code, size_t sizeInBytes) {
+  return {code, code + sizeInBytes / sizeof(uint32_t)};
 }
 
-openvdb::FloatGrid::Ptr loadFirstFloatGrid(const std::filesystem::path& vdbPath) {
-  openvdb::initialize();
+// Grows [sceneMin, sceneMax] by the local box of an instance placed with localToWorld.
+void growWorldBounds(const glm::mat4 &localToWorld, const glm::vec3 &bboxMin,
+                     const glm::vec3 &bboxMax, glm::vec3 &sceneMin, glm::vec3 &sceneMax) {
+  for (int corner = 0; corner < 8; ++corner) {
+    const glm::vec3 local((corner & 1) ? bboxMax.x : bboxMin.x,
+                          (corner & 2) ? bboxMax.y : bboxMin.y,
+                          (corner & 4) ? bboxMax.z : bboxMin.z);
+    const glm::vec3 world(localToWorld * glm::vec4(local, 1.0f));
+    sceneMin = glm::min(sceneMin, world);
+    sceneMax = glm::max(sceneMax, world);
+  }
+}
 
-  openvdb::io::File file(vdbPath.string());
-  file.open();
+} // namespace
 
-  openvdb::FloatGrid::Ptr floatGrid;
-  for (auto it = file.beginName(); it != file.endName(); ++it) {
-    auto gridBase = file.readGrid(*it);
-    floatGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(gridBase);
-    if (floatGrid) {
-      break;
+RenderBackend peacock::parseRenderBackend(const std::string &name, bool rayTracingSupported) {
+  if (name == "auto") {
+    return rayTracingSupported ? RenderBackend::eRayTracing : RenderBackend::eCompute;
+  }
+  for (RenderBackend backend : {RenderBackend::eRayTracing, RenderBackend::eCompute,
+                                RenderBackend::eComputeMorton, RenderBackend::eWavefront}) {
+    if (name == renderBackendName(backend)) {
+      if (backend == RenderBackend::eRayTracing && !rayTracingSupported) {
+        throw std::runtime_error("The raytracing backend needs VK_KHR_ray_tracing_pipeline, "
+                                 "which this device does not support");
+      }
+      return backend;
     }
   }
+  throw std::runtime_error(
+      "Unknown backend (expected auto, raytracing, compute, compute-morton or wavefront): " +
+      name);
+}
 
-  file.close();
-
-  if (!floatGrid) {
-    throw std::runtime_error("No float grid found in VDB file: " + vdbPath.string());
+const char *peacock::renderBackendName(RenderBackend backend) {
+  switch (backend) {
+    case RenderBackend::eCompute:       return "compute";
+    case RenderBackend::eComputeMorton: return "compute-morton";
+    case RenderBackend::eWavefront:     return "wavefront";
+    default:                            return "raytracing";
   }
+}
 
-  return floatGrid;
+shaderio::SampleSequence peacock::parseSampleSequence(const std::string &name) {
+  for (shaderio::SampleSequence sequence :
+       {shaderio::eSequenceIndependent, shaderio::eSequenceSobol, shaderio::eSequenceRank1}) {
+    if (name == sampleSequenceName(sequence)) {
+      return sequence;
+    }
+  }
+  throw std::runtime_error("Unknown sampler (expected independent, sobol or rank1): " + name);
 }
 
-shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<float>& grid,
-                                    uint32_t gridByteSize) {
-  shaderio::VolumeDesc desc{};
-  desc.worldToIndex = glm::transpose(makeWorldToIndexMatrix(grid.map()));
+const char *peacock::sampleSequenceName(shaderio::SampleSequence sequence) {
+  switch (sequence) {
+    case shaderio::eSequenceIndependent: return "independent";
+    case shaderio::eSequenceRank1:       return "rank1";
+    default:                             return "sobol";
+  }
+}
 
-  const auto bbox = grid.worldBBox();
-  printf("[Volume] worldBBox min=(%.4f, %.4f, %.4f) max=(%.4f, %.4f, %.4f)\n",
-         bbox.min()[0], bbox.min()[1], bbox.min()[2],
-         bbox.max()[0], bbox.max()[1], bbox.max()[2]);
-  desc.bboxMin = glm::vec3(bbox.min()[0], bbox.min()[1], bbox.min()[2]);
-  desc.bboxMax = glm::vec3(bbox.max()[0], bbox.max()[1], bbox.max()[2]);
+shaderio::TransmittanceEstimator peacock::parseTransmittanceEstimator(const std::string &name) {
+  for (shaderio::TransmittanceEstimator estimator :
+       {shaderio::eTransmittanceRatio, shaderio::eTransmittanceResidualRatio,
+        shaderio::eTransmittanceTrackLength}) {
+    if (name == transmittanceEstimatorName(estimator)) {
+      return estimator;
+    }
+  }
+  throw std::runtime_error(
+      "Unknown transmittance estimator (expected residual, ratio or track-length): " + name);
+}
 
-  desc.sigma_a      = glm::vec3(0.0f);        // pure-scattering smoke: no absorption
-  desc.sigma_s      = glm::vec3(1.0f);        // unit scattering scale
-  desc.Le           = glm::vec3(0.0f);        // non-emissive
-  desc.densityScale = 0.1f;
-  desc.g            = 0.0f;                   // isotropic
-  desc.stepSize     = 0.5f;
+const char *peacock::transmittanceEstimatorName(shaderio::TransmittanceEstimator estimator) {
+  switch (estimator) {
+    case shaderio::eTransmittanceRatio:       return "ratio";
+    case shaderio::eTransmittanceTrackLength: return "track-length";
+    default:                                  return "residual";
+  }
+}
 
-  const float maxDensity = static_cast<float>(grid.tree().root().maximum());
-  desc.majorant = std::max(maxDensity * desc.densityScale, 1e-6f);
-  return desc;
+uint32_t peacock::parseRestirReuse(const std::string &name) {
+  for (uint32_t reuse = 0; reuse <= (shaderio::kRestirTemporal | shaderio::kRestirSpatial); ++reuse) {
+    if (name == restirReuseName(reuse)) {
+      return reuse;
+    }
+  }
+  throw std::runtime_error("Unknown light reuse (expected none, temporal, spatial or both): " + name);
 }
 
-} // namespace
+const char *peacock::restirReuseName(uint32_t reuse) {
+  switch (reuse & (shaderio::kRestirTemporal | shaderio::kRestirSpatial)) {
+    case shaderio::kRestirTemporal: return "temporal";
+    case shaderio::kRestirSpatial:  return "spatial";
+    case shaderio::kRestirTemporal | shaderio::kRestirSpatial: return "both";
+    default:                        return "none";
+  }
+}
 
 void Raytracer::onAttach(nvapp::Application *app) {
   m_app = app;
 
-  // Query ray tracing properties used by pipeline/SBT creation.
-  VkPhysicalDeviceProperties2 props2{
-      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
-  props2.pNext = &m_rtProperties;
-  vkGetPhysicalDeviceProperties2(m_app->getPhysicalDevice(), &props2);
+  // The ray tracing extensions are optional (see setRayTracingEnabled); when the
+  // device was created without them the integrator only runs through the compute
+  // pipelines.
+  m_backend = parseRenderBackend(m_settings.backend, m_rayTracingSupported);
+  if (m_rayTracingSupported) {
+    m_traceStages |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+
+    // Query ray tracing properties used by pipeline/SBT creation.
+    VkPhysicalDeviceProperties2 props2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    props2.pNext = &m_rtProperties;
+    vkGetPhysicalDeviceProperties2(m_app->getPhysicalDevice(), &props2);
+  }
+  printf("[Raytracer] backend: %s%s\n", renderBackendName(m_backend),
+         m_rayTracingSupported ? "" : " (no ray tracing pipeline support)");
 
   // Initialize the VMA allocator
   VmaAllocatorCreateInfo allocatorInfo = {
@@ -144,7 +283,7 @@ void Raytracer::onAttach(nvapp::Application *app) {
   // use it for staging buffers and images
   m_stagingUploader.init(&m_allocator, true);
 
-  // Setting up the Slang compiler for hot reload shader
+  // Setting up the Slang compiler for shader hot reload (see rebuildShaders)
   m_slangCompiler.addSearchPaths(peacock::getShaderDirs());
   m_slangCompiler.defaultTarget();
   m_slangCompiler.defaultOptions();
@@ -168,29 +307,120 @@ void Raytracer::onAttach(nvapp::Application *app) {
   m_gBuffers.init(gBufferInit);
 
   // Initialize SBT generator with queried ray tracing properties.
-  m_sbtGenerator.init(m_app->getDevice(), m_rtProperties);
+  if (m_rayTracingSupported) {
+    m_sbtGenerator.init(m_app->getDevice(), m_rtProperties);
+  }
 
-  loadVolume("/home/jyxiong/Projects/peacock/asset/bunny_cloud.vdb");
-  loadHdrIbl("/home/jyxiong/Projects/peacock/asset/belfast_sunset_puresky_2k.hdr");
+  m_scene = m_settings.scenePath.empty() ? VolumeScene::single(m_settings.volumePath)
+                                         : VolumeScene::load(m_settings.scenePath);
+  loadScene(m_scene);
+  loadHdrIbl(m_settings.hdrPath);
+  loadLights();
+
+  // Sequence frames replace the grid buffers wholesale, so they need a single volume.
+  if (m_settings.sequence && !m_settings.headless) {
+    if (m_instances.size() == 1) {
+      m_sequence.init(m_app, &m_allocator,
+                      VolumeSequencePlayer::findSequence(m_scene.volumes.front()), m_settings);
+    } else {
+      printf("[Scene] --sequence needs a scene with a single instance, ignored\n");
+    }
+  }
 
-  setupCameraForBox(m_cameraManip, m_volumeDesc.bboxMin,
-                    m_volumeDesc.bboxMax, 1.0f);
+  if (m_settings.hasCamera()) {
+    m_cameraManip->setFov(m_settings.fov);
+    m_cameraManip->setLookat(m_settings.eye, m_settings.center, m_settings.up);
+  } else {
+    setupCameraForBox(m_cameraManip, m_volumeDesc.bboxMin,
+                      m_volumeDesc.bboxMax, 1.0f);
+  }
+
+  m_sceneInfo.sampleSequence = parseSampleSequence(m_settings.sampler);
+  m_sceneInfo.lodDepth = m_settings.lodDepth;
+  m_sceneInfo.lodShadowDepth = m_settings.lodShadowDepth;
+  m_sceneInfo.transmittanceEstimator = parseTransmittanceEstimator(m_settings.transmittance);
+  m_sceneInfo.risCandidates = m_settings.lightCandidates;
+  m_sceneInfo.risReuse = parseRestirReuse(m_settings.lightReuse);
+  m_sceneInfo.aovs = denoising() ? 1u : 0u;
+  createTransmittanceCache();
+  if (m_settings.headless) {
+    m_sceneInfo.sampleCount = std::max(m_settings.sppPerDispatch, 1u);
+  }
 
   createResources();
   createRaytraceDescriptorLayout();
-  createRayTracingPipeline();
+  createPipelineLayout();
+  if (m_settings.pipelineCache) {
+    const std::filesystem::path cachePath =
+        m_settings.pipelineCachePath.empty()
+            ? nvutils::getExecutablePath().parent_path() / "peacock_pipelines.cache"
+            : m_settings.pipelineCachePath;
+    m_pipelineCache.init(m_app->getDevice(), m_app->getPhysicalDevice(), cachePath);
+  }
+  m_spirv = rendererSpirv();
+  m_variants.emplace(PipelineVariant{}, createPipelines(m_spirv, PipelineVariant{}));
+  bindPipelineVariant(PipelineVariant{});
+  m_pipelineCache.save();
+
+  if (m_settings.hotReload && !m_settings.headless) {
+    const std::filesystem::path shaderDir = findShaderDirectory();
+    if (shaderDir.empty()) {
+      printf("[Shaders] renderer.slang not found, hot reload disabled\n");
+    } else {
+      m_shaderReloader.start(shaderDir, [this] { return rebuildShaders(); });
+    }
+  }
+
+  m_profiler.init(m_app->getDevice(), m_app->getPhysicalDevice(), m_app->getQueue(0).familyIndex,
+                  m_settings.headless ? m_settings.dispatchesPerFrame : 1);
+  if (!m_settings.statsCsvPath.empty()) {
+    m_profiler.startCsv(m_settings.statsCsvPath);
+  }
 }
 
 void Raytracer::onDetach() {
+  m_shaderReloader.stop();  // no rebuild may be creating pipelines from here on
   NVVK_CHECK(vkQueueWaitIdle(m_app->getQueue(0).queue));
+  m_profiler.flush();
+  m_profiler.deinit();
+  m_sequence.deinit();
 
   vkDestroyPipelineLayout(m_app->getDevice(), m_rtPipelineLayout, nullptr);
-  vkDestroyPipeline(m_app->getDevice(), m_rtPipeline, nullptr);
+  if (m_variantBuild.valid()) {
+    PipelineSet pipelines = m_variantBuild.get();
+    destroyPipelines(pipelines);
+  }
+  for (auto &[variant, pipelines] : m_variants) {
+    destroyPipelines(pipelines);
+  }
+  m_variants.clear();
+  m_pipelines = {};
+  if (m_pendingShaders) {
+    destroyPipelines(m_pendingShaders->pipelines);
+    m_pendingShaders.reset();
+  }
 
   m_allocator.destroyBuffer(m_sbtBuffer);
   m_allocator.destroyBuffer(m_bSceneInfo);
+  m_allocator.destroyBuffer(m_bAccum);
+  m_allocator.destroyBuffer(m_bHistory);
+  m_allocator.destroyBuffer(m_bConvergence);
+  m_allocator.destroyBuffer(m_bWavefrontPaths);
+  m_allocator.destroyBuffer(m_bWavefrontQueues);
+  m_allocator.destroyBuffer(m_bWavefrontCounters);
   m_allocator.destroyBuffer(m_bVolumeDesc);
   m_allocator.destroyBuffer(m_bVolumeGrid);
+  m_allocator.destroyBuffer(m_bMajorantGrid);
+  m_allocator.destroyBuffer(m_bVolumeInstances);
+  m_allocator.destroyBuffer(m_bEnvDistribution);
+  m_allocator.destroyBuffer(m_bLights);
+  m_allocator.destroyBuffer(m_bReservoirs);
+  m_allocator.destroyBuffer(m_bAov);
+  m_allocator.destroyBuffer(m_bDenoise);
+  m_allocator.destroyBuffer(m_bTransmittanceCache);
+  if (m_useRayQuery) {
+    m_asBuilder.deinit();
+  }
 
   if (m_hdrImageView != VK_NULL_HANDLE) {
     vkDestroyImageView(m_app->getDevice(), m_hdrImageView, nullptr);
@@ -202,13 +432,20 @@ void Raytracer::onDetach() {
   m_gBuffers.deinit();
   m_samplerPool.deinit();
   m_stagingUploader.deinit();
-  m_sbtGenerator.deinit();
+  if (m_rayTracingSupported) {
+    m_sbtGenerator.deinit();
+  }
+  m_pipelineCache.deinit();
   m_allocator.deinit();
 }
 
 void Raytracer::onResize(VkCommandBuffer cmd, const VkExtent2D &size) {
   NVVK_CHECK(m_gBuffers.update(cmd, size));
-  if (size.height > 0) {
+  createAccumBuffer(size);
+  createReservoirBuffer(cmd, size);
+  createDenoiseBuffers(size);
+  m_sceneInfo.frameIndex = 0;
+  if (size.height > 0 && !m_settings.hasCamera()) {
     const float aspect = static_cast<float>(size.width) / static_cast<float>(size.height);
     setupCameraForBox(m_cameraManip, m_volumeDesc.bboxMin,
                       m_volumeDesc.bboxMax, aspect);
@@ -227,6 +464,10 @@ void Raytracer::onUIRender() {
                         static_cast<int>(ImGui::GetIO().Framerate),
                         1000.F / ImGui::GetIO().Framerate);
 
+    statisticsUI();
+    variantsUI();
+    shadersUI();
+
     if (ImGui::CollapsingHeader("Camera")) {
       nvgui::CameraWidget(m_cameraManip);
     }
@@ -234,18 +475,139 @@ void Raytracer::onUIRender() {
     if (ImGui::CollapsingHeader("Path Tracer", ImGuiTreeNodeFlags_DefaultOpen)) {
       bool changed = false;
 
-      // Samples per pixel
-      int spp = static_cast<int>(m_sceneInfo.sampleCount);
-      if (ImGui::SliderInt("Samples / pixel", &spp, 1, 64)) {
-        m_sceneInfo.sampleCount = static_cast<unsigned int>(spp);
+      // Same integrator and accumulation, so switching keeps the image
+      int backend = static_cast<int>(m_backend);
+      const char *backends[] = {"Ray tracing pipeline", "Compute (8x8 tiles)",
+                                "Compute (Morton 8x8)", "Wavefront"};
+      if (ImGui::Combo("Backend", &backend, backends, IM_ARRAYSIZE(backends))) {
+        if (backend != static_cast<int>(RenderBackend::eRayTracing) || m_rayTracingSupported) {
+          m_backend = static_cast<RenderBackend>(backend);
+        }
+      }
+      if (m_backend == RenderBackend::eWavefront) {
+        ImGui::Checkbox("Sort by leaf", &m_settings.wavefrontSort);
+      }
+
+      // Samples per pixel: fixed, or scheduled against a GPU time budget per frame
+      ImGui::SliderFloat("Frame budget (ms)", &m_settings.frameBudgetMs, 0.0f, 100.0f, "%.1f");
+      if (m_settings.frameBudgetMs > 0.0f && m_profiler.enabled()) {
+        ImGui::SliderFloat("Idle budget (ms, 0 = inf)", &m_settings.idleFrameBudgetMs, 0.0f,
+                           1000.0f, "%.0f");
+        ImGui::Checkbox("Split into bands over budget", &m_settings.tiledFrames);
+        ImGui::LabelText("Samples / pixel", "%u (band %u of %u)", m_sceneInfo.sampleCount,
+                         m_sceneInfo.tileIndex + 1, m_sceneInfo.tileCount);
+      } else {
+        int spp = static_cast<int>(m_sceneInfo.sampleCount);
+        if (ImGui::SliderInt("Samples / pixel", &spp, 1, kMaxFrameSpp)) {
+          m_sceneInfo.sampleCount = static_cast<unsigned int>(spp);
+          changed = true;
+        }
+      }
+
+      // Same estimator, only the convergence rate differs; restart to compare
+      int sequence = static_cast<int>(m_sceneInfo.sampleSequence);
+      const char *sequences[] = {"Independent (PCG)", "Sobol (Owen-scrambled)",
+                                 "Rank-1 (blue noise)"};
+      if (ImGui::Combo("Sampler", &sequence, sequences, IM_ARRAYSIZE(sequences))) {
+        m_sceneInfo.sampleSequence = static_cast<unsigned int>(sequence);
+        changed = true;
+      }
+
+      // All three are unbiased; they trade density lookups per shadow ray for variance
+      int estimator = static_cast<int>(m_sceneInfo.transmittanceEstimator);
+      const char *estimators[] = {"Ratio tracking", "Residual ratio tracking", "Track length"};
+      if (ImGui::Combo("Transmittance", &estimator, estimators, IM_ARRAYSIZE(estimators))) {
+        m_sceneInfo.transmittanceEstimator = static_cast<unsigned int>(estimator);
         changed = true;
       }
 
+      // Resampled direct lighting: one shadow ray for the best of N light candidates
+      int candidates = static_cast<int>(m_sceneInfo.risCandidates);
+      if (ImGui::SliderInt("Light candidates", &candidates, 0, 64)) {
+        m_sceneInfo.risCandidates = static_cast<unsigned int>(candidates);
+        changed = true;
+      }
+      if (m_sceneInfo.risCandidates > 0) {
+        int reuse = static_cast<int>(m_sceneInfo.risReuse);
+        const char *reuses[] = {"None", "Temporal", "Spatial", "Temporal + spatial"};
+        if (ImGui::Combo("Reservoir reuse", &reuse, reuses, IM_ARRAYSIZE(reuses))) {
+          m_sceneInfo.risReuse = static_cast<unsigned int>(reuse);
+          changed = true;
+        }
+      }
+
       // Maximum scattering depth per path
       if (ImGui::SliderInt("Max scatter depth", &m_sceneInfo.maxScatterDepth, 1, 32)) {
         changed = true;
       }
 
+      // Coarse density levels for deep bounces; 0 renders at full resolution
+      if (m_settings.lodLevels > 0) {
+        int lodDepth = static_cast<int>(m_sceneInfo.lodDepth);
+        if (ImGui::SliderInt("LOD from depth", &lodDepth, 0, 16)) {
+          m_sceneInfo.lodDepth = static_cast<unsigned int>(lodDepth);
+          changed = true;
+        }
+        int lodShadowDepth = static_cast<int>(m_sceneInfo.lodShadowDepth);
+        if (ImGui::SliderInt("Shadow LOD from depth", &lodShadowDepth, 0, 16)) {
+          m_sceneInfo.lodShadowDepth = static_cast<unsigned int>(lodShadowDepth);
+          changed = true;
+        }
+      }
+
+      // Shadow rays from this depth read the transmittance cache; 0 tracks them all
+      int cacheDepth = static_cast<int>(m_settings.transmittanceCacheDepth);
+      if (ImGui::SliderInt("Cached shadows from depth", &cacheDepth, 0, 16)) {
+        m_settings.transmittanceCacheDepth = static_cast<uint32_t>(cacheDepth);
+        changed = true;
+      }
+      if (transmittanceCachePending()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(building)");
+      }
+
+      // Adaptive sampling: 0 disables the convergence test
+      if (ImGui::SliderFloat("Noise threshold", &m_settings.noiseThreshold, 0.0f, 0.1f, "%.4f")) {
+        changed = true;
+      }
+      int minSpp = static_cast<int>(m_settings.adaptiveMinSpp);
+      if (ImGui::SliderInt("Adaptive min samples", &minSpp, 2, 256)) {
+        m_settings.adaptiveMinSpp = static_cast<uint32_t>(minSpp);
+        changed = true;
+      }
+      if (m_settings.noiseThreshold > 0.0f) {
+        ImGui::LabelText("Converged", "%.2f%%%s", m_convergedFraction * 100.0f,
+                         m_converged ? " (stopped)" : "");
+      }
+
+      ImGui::Checkbox("Reproject on camera motion", &m_settings.reproject);
+      ImGui::Checkbox("Ray-marched preview while changing", &m_settings.preview);
+      if (m_settings.preview) {
+        changed |= ImGui::SliderFloat("Preview step (voxels)", &m_volumeDesc.stepSize, 0.25f, 8.0f,
+                                      "%.2f", ImGuiSliderFlags_Logarithmic);
+      }
+
+      // Denoiser; its AOVs start over with the accumulation, the filter settings
+      // apply to the current image
+      if (ImGui::Checkbox("Denoise", &m_settings.denoise)) {
+        m_sceneInfo.aovs = denoising() ? 1u : 0u;
+        changed = true;
+      }
+      if (m_settings.denoise) {
+        int passes = static_cast<int>(m_settings.denoisePasses);
+        if (ImGui::SliderInt("Denoise passes", &passes, 1, 8)) {
+          m_settings.denoisePasses = static_cast<uint32_t>(passes);
+          m_denoiseDirty = true;
+        }
+        m_denoiseDirty |= ImGui::SliderFloat("Luminance sigma", &m_settings.denoiseLuminanceSigma,
+                                             0.5f, 16.0f, "%.2f");
+        m_denoiseDirty |= ImGui::SliderFloat("Depth sigma", &m_settings.denoiseDepthSigma,
+                                             0.01f, 1.0f, "%.3f");
+        m_denoiseDirty |= ImGui::SliderFloat("Transmittance sigma",
+                                             &m_settings.denoiseTransmittanceSigma, 0.01f, 1.0f,
+                                             "%.3f");
+      }
+
       ImGui::LabelText("Frame index", "%u", m_sceneInfo.frameIndex);
 
       if (ImGui::Button("Reset accumulation")) {
@@ -253,7 +615,7 @@ void Raytracer::onUIRender() {
       }
 
       if (changed) {
-        m_sceneInfo.frameIndex = 0;
+        restartAfterEdit();
       }
     }
   }
@@ -261,18 +623,19 @@ void Raytracer::onUIRender() {
 
   if (ImGui::Begin("Medium")) {
     bool changed = false;
+    bool extinctionChanged = false;  // the transmittance cache must be rebuilt
 
     // Density scale — scales raw voxel values; also updates majorant
     float ds = m_volumeDesc.densityScale;
     if (ImGui::SliderFloat("Density scale", &ds, 0.001f, 2.0f, "%.4f")) {
       m_volumeDesc.densityScale = ds;
       m_volumeDesc.majorant = std::max(m_maxDensity * ds, 1e-6f);
-      changed = true;
+      extinctionChanged = true;
     }
 
     // Absorption / scattering spectrum scale
-    if (ImGui::ColorEdit3("sigma_a", &m_volumeDesc.sigma_a.x)) { changed = true; }
-    if (ImGui::ColorEdit3("sigma_s", &m_volumeDesc.sigma_s.x)) { changed = true; }
+    if (ImGui::ColorEdit3("sigma_a", &m_volumeDesc.sigma_a.x)) { extinctionChanged = true; }
+    if (ImGui::ColorEdit3("sigma_s", &m_volumeDesc.sigma_s.x)) { extinctionChanged = true; }
     if (ImGui::ColorEdit3("Le",      &m_volumeDesc.Le.x))      { changed = true; }
 
     // HG anisotropy: negative = back-scattering, 0 = isotropic, positive = forward-scattering
@@ -280,13 +643,73 @@ void Raytracer::onUIRender() {
       changed = true;
     }
 
+    if (extinctionChanged) {
+      invalidateTransmittanceCache();
+      changed = true;
+    }
     if (changed) {
-      m_sceneInfo.frameIndex = 0;
+      restartAfterEdit();
+    }
+
+    if (m_instances.size() > 1) {
+      ImGui::LabelText("Instances", "%zu (%s)", m_instances.size(),
+                       m_useRayQuery ? "ray query" : "linear test");
+    }
+
+    if (!m_sequence.empty() && ImGui::CollapsingHeader("Sequence", ImGuiTreeNodeFlags_DefaultOpen)) {
+      ImGui::Checkbox("Play", &m_sequence.playing);
+      ImGui::SliderFloat("FPS", &m_sequence.fps, 1.0f, 60.0f, "%.1f");
+      const auto *slot = m_sequence.current();
+      ImGui::LabelText("Frame", "%u / %u", slot ? slot->frame : 0u, m_sequence.frameCount());
     }
   }
   ImGui::End();
 }
 
+// Rolling GPU timings of the last FrameProfiler::kHistorySize resolved frames.
+void Raytracer::statisticsUI() {
+  if (!ImGui::CollapsingHeader("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
+    return;
+  }
+  if (!m_profiler.enabled()) {
+    ImGui::TextDisabled("GPU timestamps unavailable");
+    return;
+  }
+
+  const FrameProfiler::Summary stats = m_profiler.summary();
+  ImGui::Text("Trace rays    %.3f ms  (min %.3f / max %.3f)", stats.traceMsMean,
+              stats.traceMsMin, stats.traceMsMax);
+  ImGui::Text("Scene update  %.3f ms", stats.sceneUpdateMsMean);
+  ImGui::Text("Paths/s       %.2f M  (GPU trace time)", stats.pathsPerSecondMean * 1e-6);
+  ImGui::Text("Samples/s     %.2f M  (frame time)", stats.samplesPerSecondMean * 1e-6);
+
+  std::vector<float> traceMs;
+  traceMs.reserve(m_profiler.history().size());
+  for (const auto &frame : m_profiler.history()) {
+    traceMs.push_back(static_cast<float>(frame.traceMs));
+  }
+  ImGui::PlotLines("##traceMs", traceMs.data(), static_cast<int>(traceMs.size()), 0, "trace ms",
+                   0.0f, std::numeric_limits<float>::max(), ImVec2(-1.0f, 48.0f));
+  if (m_profiler.droppedFrames() > 0) {
+    ImGui::TextDisabled("%llu frames without timestamps",
+                        static_cast<unsigned long long>(m_profiler.droppedFrames()));
+  }
+
+  bool csv = m_profiler.csvActive();
+  if (ImGui::Checkbox("Stream to CSV", &csv)) {
+    if (csv) {
+      m_profiler.startCsv(m_settings.statsCsvPath.empty() ? std::filesystem::path("peacock_stats.csv")
+                                                          : m_settings.statsCsvPath);
+    } else {
+      m_profiler.stopCsv();
+    }
+  }
+  if (m_profiler.csvActive()) {
+    ImGui::SameLine();
+    ImGui::TextDisabled("%s", m_profiler.csvPath().filename().string().c_str());
+  }
+}
+
 void Raytracer::onUIMenu() {
   if (ImGui::BeginMenu("File")) {
     if (ImGui::MenuItem("Exit", "Ctrl+Q"))
@@ -297,36 +720,106 @@ void Raytracer::onUIMenu() {
     m_app->close();
 }
 
-void Raytracer::loadVolume(const std::filesystem::path& vdbPath) {
-  if (!std::filesystem::exists(vdbPath)) {
-    throw std::runtime_error("Volume file does not exist: " + vdbPath.string());
-  }
-
-  auto floatGrid = loadFirstFloatGrid(vdbPath);
-  m_gridHandle = nanovdb::tools::createNanoGrid(*floatGrid);
+//---------------------------------------------------------------------------------------------------------------
+// Loads every volume of the scene and uploads their grids and majorant grids, packed
+// one after the other into a single buffer each, plus the instance list that places
+// them. VolumeDesc keeps the scene-wide medium parameters and the geometry of volume
+// 0 (sequence frames, wavefront sort key); its bounds become the union of the
+// instance bounds, which frames the camera.
+//
+void Raytracer::loadScene(const VolumeScene &scene) {
+  const VolumeLoadOptions options = VolumeLoadOptions::fromSettings(m_settings);
+  const auto uploadStart = std::chrono::steady_clock::now();
+
+  struct PackedVolume {
+    shaderio::VolumeDesc desc;
+    MajorantGrid majorants;
+    DensityPyramid pyramid;
+    float maxDensity{0.0f};
+    VkDeviceSize gridOffset{0};
+    VkDeviceSize lodGridOffset[shaderio::kMaxDensityLods]{};
+    VkDeviceSize majorantOffset{0};  // in floats
+  };
+  std::vector<PackedVolume> volumes(scene.volumes.size());
+  VkDeviceSize gridByteSize = 0;
+  VkDeviceSize majorantCells = 0;
+  m_hostVolumes.clear();
+  for (size_t i = 0; i < scene.volumes.size(); ++i) {
+    m_hostVolumes.push_back(HostVolume::load(scene.volumes[i], options));
+    PackedVolume &volume = volumes[i];
+    m_hostVolumes.back().visit([&](const auto &nanoGrid) {
+      volume.maxDensity = static_cast<float>(nanoGrid.tree().root().maximum());
+      volume.desc = makeVolumeDesc(nanoGrid);
+      volume.majorants = MajorantGrid::build(nanoGrid, m_settings.majorantCellSize);
+      volume.pyramid = DensityPyramid::build(nanoGrid, m_settings.lodLevels);
+    });
+    volume.majorants.describe(volume.desc);
+    for (uint32_t l = 1; l <= volume.pyramid.levelCount(); ++l) {
+      volume.majorants.addLevel(volume.pyramid.level(l), 1u << l);
+    }
 
-  const auto* nanoGrid = m_gridHandle.grid<float>();
-  if (!nanoGrid) {
-    throw std::runtime_error("Failed to convert VDB float grid to NanoVDB: " +
-                             vdbPath.string());
+    gridByteSize = (gridByteSize + kGridAlignment - 1) / kGridAlignment * kGridAlignment;
+    volume.gridOffset = gridByteSize;
+    gridByteSize += m_hostVolumes.back().size();
+    for (uint32_t l = 1; l <= volume.pyramid.levelCount(); ++l) {
+      gridByteSize = (gridByteSize + kGridAlignment - 1) / kGridAlignment * kGridAlignment;
+      volume.lodGridOffset[l - 1] = gridByteSize;
+      gridByteSize += volume.pyramid.size(l);
+    }
+    volume.majorantOffset = majorantCells;
+    majorantCells += volume.majorants.floatCount();
+  }
+  // PNanoVDB addresses the buffer with 32-bit byte offsets
+  if (gridByteSize > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("The volumes of the scene exceed 4 GB of grid data");
   }
 
-  m_maxDensity = static_cast<float>(nanoGrid->tree().root().maximum());
-  m_volumeDesc = makeVolumeDesc(*nanoGrid,
-                                static_cast<uint32_t>(m_gridHandle.gridSize()));
+  m_instances.clear();
+  m_maxDensity = 0.0f;
+  glm::vec3 sceneMin(std::numeric_limits<float>::max());
+  glm::vec3 sceneMax(-std::numeric_limits<float>::max());
+  for (const VolumeScene::Instance &source : scene.instances) {
+    const PackedVolume &volume = volumes[source.volume];
+    shaderio::VolumeInstance instance{};
+    instance.worldToLocal = glm::transpose(glm::inverse(source.localToWorld));
+    instance.localToIndex = volume.desc.worldToIndex;
+    instance.bboxMin = volume.desc.bboxMin;
+    instance.bboxMax = volume.desc.bboxMax;
+    instance.gridOffset = static_cast<uint32_t>(volume.gridOffset);
+    instance.majorantOffset = static_cast<uint32_t>(volume.majorantOffset);
+    instance.majorantGridMin = volume.desc.majorantGridMin;
+    instance.majorantCellSize = volume.desc.majorantCellSize;
+    instance.majorantGridRes = volume.desc.majorantGridRes;
+    instance.densityScale = source.density;
+    instance.sigma_a = source.sigma_a;
+    instance.sigma_s = source.sigma_s;
+    instance.g = source.g;
+    instance.flags = source.overrideG ? shaderio::kVolumeInstanceOverrideG : 0u;
+    instance.lodLevels = volume.pyramid.levelCount();
+    for (uint32_t l = 0; l < instance.lodLevels; ++l) {
+      instance.lodGridOffset[l] = static_cast<uint32_t>(volume.lodGridOffset[l]);
+    }
+    m_instances.push_back(instance);
 
-  const VkDeviceSize gridByteSize = static_cast<VkDeviceSize>(m_gridHandle.gridSize());
-  if(m_gridHandle.data() == nullptr) {
-    throw std::runtime_error("NanoVDB handle does not contain raw grid data: " +
-                             vdbPath.string());
+    growWorldBounds(source.localToWorld, instance.bboxMin, instance.bboxMax, sceneMin, sceneMax);
+    m_maxDensity = std::max(m_maxDensity, volume.maxDensity * source.density);
   }
 
-  // Upload buffers
+  m_volumeDesc = volumes.front().desc;
+  m_volumeDesc.bboxMin = sceneMin;
+  m_volumeDesc.bboxMax = sceneMax;
+  m_volumeDesc.majorant = std::max(m_maxDensity * m_volumeDesc.densityScale, 1e-6f);
+  m_sceneInfo.instanceCount = static_cast<uint32_t>(m_instances.size());
+  m_useRayQuery = m_rayQuerySupported && m_instances.size() > 1;
+
+  // Upload buffers; a cache-mapped grid is paged in directly by the staging copy
   assert(m_stagingUploader.isAppendedEmpty());
   VkCommandBuffer cmd = m_app->createTempCmdBuffer();
   {
     m_allocator.destroyBuffer(m_bVolumeDesc);
     m_allocator.destroyBuffer(m_bVolumeGrid);
+    m_allocator.destroyBuffer(m_bMajorantGrid);
+    m_allocator.destroyBuffer(m_bVolumeInstances);
 
     // Create a buffer (UBO) to store the volume description
     NVVK_CHECK(m_allocator.createBuffer(m_bVolumeDesc, sizeof(shaderio::VolumeDesc),
@@ -342,24 +835,172 @@ void Raytracer::loadVolume(const std::filesystem::path& vdbPath) {
                       VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
                         VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
                       VMA_MEMORY_USAGE_AUTO));
-    NVVK_CHECK(m_stagingUploader.appendBuffer(m_bVolumeGrid, 0, gridByteSize,
-                                              m_gridHandle.data()));
+    for (size_t i = 0; i < volumes.size(); ++i) {
+      NVVK_CHECK(m_stagingUploader.appendBuffer(m_bVolumeGrid, volumes[i].gridOffset,
+                                                m_hostVolumes[i].size(), m_hostVolumes[i].data()));
+      const DensityPyramid &pyramid = volumes[i].pyramid;
+      for (uint32_t l = 1; l <= pyramid.levelCount(); ++l) {
+        NVVK_CHECK(m_stagingUploader.appendBuffer(m_bVolumeGrid, volumes[i].lodGridOffset[l - 1],
+                                                  pyramid.size(l), pyramid.data(l)));
+      }
+    }
     NVVK_DBG_NAME(m_bVolumeGrid.buffer);
+
+    NVVK_CHECK(m_allocator.createBuffer(m_bMajorantGrid, majorantCells * sizeof(float),
+                                        VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                        VMA_MEMORY_USAGE_AUTO));
+    std::vector<float> packed;
+    for (const PackedVolume &volume : volumes) {
+      packed.resize(volume.majorants.floatCount());
+      volume.majorants.pack(packed.data());
+      NVVK_CHECK(m_stagingUploader.appendBuffer(m_bMajorantGrid,
+                                                volume.majorantOffset * sizeof(float),
+                                                volume.majorants.byteSize(), packed.data()));
+    }
+    NVVK_DBG_NAME(m_bMajorantGrid.buffer);
+
+    const VkDeviceSize instanceByteSize = m_instances.size() * sizeof(shaderio::VolumeInstance);
+    NVVK_CHECK(m_allocator.createBuffer(m_bVolumeInstances, instanceByteSize,
+                                        VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                        VMA_MEMORY_USAGE_AUTO));
+    NVVK_CHECK(m_stagingUploader.appendBuffer(m_bVolumeInstances, 0, instanceByteSize,
+                                              m_instances.data()));
+    NVVK_DBG_NAME(m_bVolumeInstances.buffer);
   }
 
   m_stagingUploader.cmdUploadAppended(cmd);
   m_app->submitAndWaitTempCmdBuffer(cmd);
   m_stagingUploader.releaseStaging();
   m_volumeUploaded = true;
+
+  if (m_useRayQuery) {
+    createAccelerationStructures();
+  }
+
+  printf("[Volume] uploaded %zu volume(s), %.1f MB in %.1f ms, peak RSS %.1f MB\n",
+         volumes.size(), gridByteSize / (1024.0 * 1024.0),
+         std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart)
+             .count(),
+         peakResidentBytes() / (1024.0 * 1024.0));
+  if (m_instances.size() > 1) {
+    printf("[Scene] %zu instances, %s traversal\n", m_instances.size(),
+           m_useRayQuery ? "ray query" : "linear (no VK_KHR_ray_query)");
+  }
 }
 
-void Raytracer::loadHdrIbl(const std::filesystem::path &hdrPath) {
-  int width, height, channels;
-  auto* data = stbi_loadf(hdrPath.string().c_str(), &width, &height, &channels, 4);
-  if (!data) {
-    throw std::runtime_error("Failed to load HDR image: " + hdrPath.string());
+//---------------------------------------------------------------------------------------------------------------
+// One BLAS per distinct volume holding a single AABB (its grid-world bounds) and a
+// TLAS placing it once per instance. The custom index is the instance id, which the
+// shader uses to fetch the VolumeInstance of a candidate.
+//
+void Raytracer::createAccelerationStructures() {
+  SCOPED_TIMER(__FUNCTION__);
+  m_asBuilder.init(&m_allocator, &m_stagingUploader, m_app->getQueue(0));
+
+  std::vector<VkAabbPositionsKHR> aabbs(m_scene.volumes.size());
+  for (size_t i = 0; i < m_instances.size(); ++i) {
+    const shaderio::VolumeInstance &instance = m_instances[i];
+    aabbs[m_scene.instances[i].volume] = {instance.bboxMin.x, instance.bboxMin.y,
+                                          instance.bboxMin.z, instance.bboxMax.x,
+                                          instance.bboxMax.y, instance.bboxMax.z};
   }
-  auto imageByteSize = static_cast<VkDeviceSize>(width) * static_cast<VkDeviceSize>(height) * 4 * sizeof(float);
+
+  nvvk::Buffer aabbBuffer;
+  const VkDeviceSize aabbByteSize = aabbs.size() * sizeof(VkAabbPositionsKHR);
+  NVVK_CHECK(m_allocator.createBuffer(
+      aabbBuffer, aabbByteSize,
+      VK_BUFFER_USAGE_2_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+          VK_BUFFER_USAGE_2_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+      VMA_MEMORY_USAGE_AUTO));
+  NVVK_DBG_NAME(aabbBuffer.buffer);
+  VkCommandBuffer cmd = m_app->createTempCmdBuffer();
+  NVVK_CHECK(m_stagingUploader.appendBuffer(aabbBuffer, 0, aabbByteSize, aabbs.data()));
+  m_stagingUploader.cmdUploadAppended(cmd);
+  m_app->submitAndWaitTempCmdBuffer(cmd);
+  m_stagingUploader.releaseStaging();
+
+  std::vector<nvvk::AccelerationStructureGeometryInfo> blasGeometries(aabbs.size());
+  for (size_t i = 0; i < aabbs.size(); ++i) {
+    nvvk::AccelerationStructureGeometryInfo &info = blasGeometries[i];
+    info.geometry = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .geometryType = VK_GEOMETRY_TYPE_AABBS_KHR,
+        .geometry = {.aabbs = {.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_AABBS_DATA_KHR,
+                               .data = {.deviceAddress = aabbBuffer.address +
+                                                         i * sizeof(VkAabbPositionsKHR)},
+                               .stride = sizeof(VkAabbPositionsKHR)}},
+        // Every overlapping instance must be gathered exactly once
+        .flags = VK_GEOMETRY_NO_DUPLICATE_ANY_HIT_INVOCATION_BIT_KHR,
+    };
+    info.rangeInfo = {.primitiveCount = 1};
+  }
+  m_asBuilder.blasSubmitBuildAndWait(blasGeometries,
+                                     VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+  m_allocator.destroyBuffer(aabbBuffer);
+
+  std::vector<VkAccelerationStructureInstanceKHR> tlasInstances;
+  tlasInstances.reserve(m_scene.instances.size());
+  for (size_t i = 0; i < m_scene.instances.size(); ++i) {
+    const VolumeScene::Instance &source = m_scene.instances[i];
+    VkAccelerationStructureInstanceKHR instance{};
+    instance.transform = toTransformMatrixKHR(source.localToWorld);
+    instance.instanceCustomIndex = static_cast<uint32_t>(i);
+    instance.mask = 0xFF;
+    instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+    instance.accelerationStructureReference = m_asBuilder.blasSet[source.volume].address;
+    tlasInstances.push_back(instance);
+  }
+  m_asBuilder.tlasSubmitBuildAndWait(tlasInstances,
+                                     VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Switches to a sequence frame that the player has just made current. Only the
+// frame geometry is taken over; the medium parameters edited in the UI persist.
+//
+void Raytracer::applyVolumeFrame(const VolumeSequencePlayer::Slot &slot) {
+  shaderio::VolumeInstance &instance = m_instances.front();
+  instance.localToIndex     = slot.desc.worldToIndex;
+  instance.bboxMin          = slot.desc.bboxMin;
+  instance.bboxMax          = slot.desc.bboxMax;
+  instance.majorantGridMin  = slot.desc.majorantGridMin;
+  instance.majorantCellSize = slot.desc.majorantCellSize;
+  instance.majorantGridRes  = slot.desc.majorantGridRes;
+  instance.lodLevels        = 0;  // the player uploads no density pyramid
+  m_instancesDirty = true;
+
+  // The scene bounds are in world space, as in loadScene
+  glm::vec3 sceneMin(std::numeric_limits<float>::max());
+  glm::vec3 sceneMax(-std::numeric_limits<float>::max());
+  growWorldBounds(m_scene.instances.front().localToWorld, slot.desc.bboxMin, slot.desc.bboxMax,
+                  sceneMin, sceneMax);
+  m_volumeDesc.worldToIndex     = slot.desc.worldToIndex;
+  m_volumeDesc.bboxMin          = sceneMin;
+  m_volumeDesc.bboxMax          = sceneMax;
+  m_volumeDesc.majorantGridMin  = slot.desc.majorantGridMin;
+  m_volumeDesc.majorantCellSize = slot.desc.majorantCellSize;
+  m_volumeDesc.majorantGridRes  = slot.desc.majorantGridRes;
+  m_maxDensity = slot.maxDensity * m_scene.instances.front().density;
+  m_volumeDesc.majorant = std::max(m_maxDensity * m_volumeDesc.densityScale, 1e-6f);
+  m_sceneInfo.frameIndex = 0;
+  invalidateTransmittanceCache();
+
+  // The start-up frame lives outside the player's slots; drop it after its last use.
+  if (m_bVolumeGrid.buffer != VK_NULL_HANDLE) {
+    m_app->submitResourceFree([this, grid = m_bVolumeGrid, majorants = m_bMajorantGrid]() mutable {
+      m_allocator.destroyBuffer(grid);
+      m_allocator.destroyBuffer(majorants);
+    });
+    m_bVolumeGrid = {};
+    m_bMajorantGrid = {};
+  }
+}
+
+void Raytracer::loadHdrIbl(const std::filesystem::path &hdrPath) {
+  m_environment = EnvironmentMap::load(hdrPath);
+  const auto imageByteSize = static_cast<VkDeviceSize>(m_environment.byteSize());
 
   assert(m_stagingUploader.isAppendedEmpty());
   VkCommandBuffer cmd = m_app->createTempCmdBuffer();
@@ -369,12 +1010,13 @@ void Raytracer::loadHdrIbl(const std::filesystem::path &hdrPath) {
       m_hdrImageView = VK_NULL_HANDLE;
     }
     m_allocator.destroyImage(m_hdrImage);
+    m_allocator.destroyBuffer(m_bEnvDistribution);
 
     NVVK_CHECK(m_allocator.createImage(m_hdrImage, VkImageCreateInfo{
                                               .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
                                               .imageType = VK_IMAGE_TYPE_2D,
                                               .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-                                              .extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1},
+                                              .extent = {m_environment.width, m_environment.height, 1},
                                               .mipLevels = 1,
                                               .arrayLayers = 1,
                                               .samples = VK_SAMPLE_COUNT_1_BIT,
@@ -386,9 +1028,18 @@ void Raytracer::loadHdrIbl(const std::filesystem::path &hdrPath) {
                                           VmaAllocationCreateInfo{
                                               .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
                                           }));
-    NVVK_CHECK(m_stagingUploader.appendImage(m_hdrImage, imageByteSize, data,
+    NVVK_CHECK(m_stagingUploader.appendImage(m_hdrImage, imageByteSize, m_environment.pixels.data(),
                                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
     NVVK_DBG_NAME(m_hdrImage.image);
+
+    const auto distributionByteSize = static_cast<VkDeviceSize>(m_environment.distributionByteSize());
+    NVVK_CHECK(m_allocator.createBuffer(m_bEnvDistribution, distributionByteSize,
+                                        VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                        VMA_MEMORY_USAGE_AUTO));
+    NVVK_CHECK(m_stagingUploader.appendBuffer(m_bEnvDistribution, 0, distributionByteSize,
+                                              m_environment.distribution.data()));
+    NVVK_DBG_NAME(m_bEnvDistribution.buffer);
   }
 
   m_stagingUploader.cmdUploadAppended(cmd);
@@ -409,16 +1060,264 @@ void Raytracer::loadHdrIbl(const std::filesystem::path &hdrPath) {
   };
   NVVK_CHECK(vkCreateImageView(m_app->getDevice(), &viewInfo, nullptr, &m_hdrImageView));
   NVVK_DBG_NAME(m_hdrImageView);
+}
 
-  stbi_image_free(data);
+//---------------------------------------------------------------------------------------------------------------
+// Builds the NEE light list from the environment, the --sun-* light and the lights of
+// the scene file, weighted against the scene bounds.
+//
+void Raytracer::loadLights() {
+  std::vector<shaderio::LightDesc> sceneLights = m_scene.lights;
+  if (glm::dot(m_settings.sunRadiance, m_settings.sunRadiance) > 0.0f &&
+      glm::dot(m_settings.sunDirection, m_settings.sunDirection) > 0.0f) {
+    shaderio::LightDesc sun;
+    sun.type = shaderio::eLightDirectional;
+    sun.radiance = m_settings.sunRadiance;
+    sun.p0 = glm::normalize(m_settings.sunDirection);
+    sceneLights.push_back(sun);
+  }
+  m_lights = LightList::build(sceneLights, m_environment, m_volumeDesc.bboxMin, m_volumeDesc.bboxMax);
+  m_sceneInfo.lightCount = m_lights.count();
+  m_sceneInfo.previewLight = static_cast<unsigned int>(
+      std::max_element(m_lights.power.begin(), m_lights.power.end()) - m_lights.power.begin());
+
+  assert(m_stagingUploader.isAppendedEmpty());
+  m_allocator.destroyBuffer(m_bLights);
+  NVVK_CHECK(m_allocator.createBuffer(m_bLights, m_lights.byteSize(),
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                      VMA_MEMORY_USAGE_AUTO));
+  NVVK_CHECK(m_stagingUploader.appendBuffer(m_bLights, 0, m_lights.byteSize(),
+                                            m_lights.lights.data()));
+  NVVK_DBG_NAME(m_bLights.buffer);
+
+  VkCommandBuffer cmd = m_app->createTempCmdBuffer();
+  m_stagingUploader.cmdUploadAppended(cmd);
+  m_app->submitAndWaitTempCmdBuffer(cmd);
+  m_stagingUploader.releaseStaging();
 }
 
 void Raytracer::onRender(VkCommandBuffer cmd) {
-  if (m_rtPipeline == VK_NULL_HANDLE) {
+  installPendingPipelines();
+  selectPipelineVariant();
+  if (m_pipelines.compute[0] == VK_NULL_HANDLE) {
+    return;
+  }
+  if (m_settings.headless) {
+    renderOfflineBatch(cmd);
+    return;
+  }
+  if (const auto *slot = m_sequence.update()) {
+    applyVolumeFrame(*slot);
+  }
+  // Camera and UI changes show the ray-marched preview until they settle; the path
+  // tracer then restarts, from the reprojected pre-preview image if it is still valid.
+  // Internal restarts (cache builds, sequence frames) go straight to the path tracer.
+  const auto now = std::chrono::steady_clock::now();
+  if (cameraMoved()) {
+    m_lastChange = now;
+  }
+  if (m_settings.preview && now - m_lastChange < kPreviewHold) {
+    renderPreview(cmd);
     return;
   }
-  updateSceneBuffer(cmd);
-  raytrace(cmd);
+  if (std::exchange(m_previewShown, false)) {
+    m_sceneInfo.frameIndex = 0;
+  }
+  // Every pixel has converged: keep presenting the image until something changes.
+  if (m_converged && !restartPending()) {
+    if (m_denoiseDirty && denoising()) {
+      denoise(cmd);
+    }
+    m_denoiseDirty = false;
+    return;
+  }
+  scheduleFrame();
+  FrameProfiler::FrameInfo frameInfo = profilerFrameInfo(1);
+  m_profiler.beginFrame(cmd, frameInfo);
+  updateSceneBuffer(cmd, true);
+  buildTransmittanceCache(cmd, false);
+  // Tiled frames trace the band picked by updateSceneBuffer
+  const glm::uvec2 rows = tileRows(frameInfo.height);
+  frameInfo.height = rows.y - rows.x;
+  m_profiler.updateFrameInfo(frameInfo);
+  raytrace(cmd, true);
+  if (denoising()) {
+    denoise(cmd);
+  }
+  m_denoiseDirty = false;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Offline rendering: each headless frame records several accumulation dispatches
+// into the same command buffer, until the target sample count is reached.
+//
+void Raytracer::renderOfflineBatch(VkCommandBuffer cmd) {
+  if (m_offlineDispatches == 0) {
+    m_offlineStart = std::chrono::steady_clock::now();
+  }
+
+  const uint32_t dispatchCount = m_settings.dispatchCount();
+  if (m_converged) {
+    return;
+  }
+  m_profiler.beginFrame(cmd, profilerFrameInfo(std::min(m_settings.dispatchesPerFrame,
+                                                        dispatchCount - m_offlineDispatches)));
+  // Offline renders build the whole transmittance cache before the first sample
+  if (transmittanceCachePending()) {
+    updateSceneBuffer(cmd, false);
+    buildTransmittanceCache(cmd, true);
+  }
+  for (uint32_t i = 0; i < m_settings.dispatchesPerFrame && m_offlineDispatches < dispatchCount;
+       ++i) {
+    if (m_offlineDispatches > 0) {
+      cmdAccumulationBarrier(cmd, m_traceStages);
+    }
+    // Converged pixels are only counted once per frame, by its last dispatch.
+    const bool lastOfFrame = i + 1 == m_settings.dispatchesPerFrame ||
+                             m_offlineDispatches + 1 == dispatchCount;
+    updateSceneBuffer(cmd, lastOfFrame);
+    raytrace(cmd, lastOfFrame);
+    ++m_offlineDispatches;
+  }
+}
+
+FrameProfiler::FrameInfo Raytracer::profilerFrameInfo(uint32_t dispatches) const {
+  const VkExtent2D &size = m_app->getViewportSize();
+  return {
+      .width = size.width,
+      .height = size.height,
+      .samplesPerPixel = dispatches * m_sceneInfo.sampleCount,
+      .maxScatterDepth = static_cast<uint32_t>(m_sceneInfo.maxScatterDepth),
+      .densityScale = m_volumeDesc.densityScale,
+      .accumulatedFrames = m_sceneInfo.frameIndex,
+      .backend = renderBackendName(m_backend),
+      .variant = m_statsVariant,
+  };
+}
+
+void Raytracer::onLastHeadlessFrame() {
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                       m_offlineStart).count();
+  const VkExtent2D size = m_gBuffers.getSize();
+  const uint32_t spp = m_offlineDispatches * m_sceneInfo.sampleCount;
+  const double samples = static_cast<double>(size.width) * size.height * spp;
+  printf("[Offline] %ux%u, %u spp in %u dispatches, %s grid, %s, %s sampler, %s transmittance: "
+         "%.3f s, %.2f Msamples/s\n",
+         size.width, size.height, spp, m_offlineDispatches,
+         m_settings.volumePrecision.c_str(), renderBackendName(m_backend),
+         sampleSequenceName(static_cast<shaderio::SampleSequence>(m_sceneInfo.sampleSequence)),
+         transmittanceEstimatorName(
+             static_cast<shaderio::TransmittanceEstimator>(m_sceneInfo.transmittanceEstimator)),
+         seconds,
+         samples / std::max(seconds, 1e-9) * 1e-6);
+
+  // The last frames are still in flight; their timestamps are needed for the totals.
+  m_profiler.flush();
+  const FrameProfiler::Totals &gpu = m_profiler.totals();
+  if (gpu.frames > 0) {
+    printf("[Offline] GPU: trace %.3f s, scene update %.3f ms, %.2f Mpaths/s over %llu frames\n",
+           gpu.traceMs * 1e-3, gpu.sceneUpdateMs, gpu.samples / std::max(gpu.traceMs * 1e-3, 1e-9) * 1e-6,
+           static_cast<unsigned long long>(gpu.frames));
+  }
+  printf("[Offline] pipeline variant: %s\n", m_boundVariant.label().c_str());
+  if (m_sceneInfo.risCandidates > 0) {
+    printf("[Offline] direct light: %u candidates per shadow ray over %u lights, %s reuse\n",
+           m_sceneInfo.risCandidates, m_sceneInfo.lightCount, restirReuseName(m_sceneInfo.risReuse));
+  }
+  if (m_sceneInfo.lodDepth > 0 || m_sceneInfo.lodShadowDepth > 0) {
+    printf("[Offline] density LOD: %u levels, collisions from depth %u, shadow rays from depth %u\n",
+           m_settings.lodLevels, m_sceneInfo.lodDepth, m_sceneInfo.lodShadowDepth);
+  }
+  if (m_sceneInfo.transmittanceCacheDepth > 0) {
+    printf("[Offline] shadow cache: %u^3 cells, shadow rays from depth %u\n",
+           m_sceneInfo.transmittanceCacheRes, m_sceneInfo.transmittanceCacheDepth);
+  }
+
+  if (m_settings.noiseThreshold > 0.0f) {
+    printf("[Offline] adaptive: %.2f%% of pixels converged (threshold %.4f)%s\n",
+           m_convergedFraction * 100.0f, m_settings.noiseThreshold,
+           m_converged ? ", stopped early" : "");
+  }
+
+  const std::vector<float> rgb = readbackImage(m_bAccum, 0, 2);
+  if (!denoising()) {
+    saveImage(m_settings.outputPath, rgb);
+    return;
+  }
+
+  // The denoised image replaces --output; the raw one is kept for comparison
+  VkCommandBuffer cmd = m_app->createTempCmdBuffer();
+  denoise(cmd);
+  m_app->submitAndWaitTempCmdBuffer(cmd);
+  const VkExtent2D size = m_gBuffers.getSize();
+  const VkDeviceSize lastSlot = (m_settings.denoisePasses - 1) & 1;
+  const std::filesystem::path &output = m_settings.outputPath;
+  printf("[Offline] denoised with %u a-trous passes\n", m_settings.denoisePasses);
+  saveImage(output, readbackImage(m_bDenoise, lastSlot * size.width * size.height, 1));
+  saveImage(output.parent_path() /
+                (output.stem().string() + ".noisy" + output.extension().string()),
+            rgb);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Reads the mean radiance back from an fp32 per-pixel buffer (the accumulation or
+// the denoiser's), whose pixels start with the rgb mean every vec4PerPixel vec4s.
+//
+std::vector<float> Raytracer::readbackImage(const nvvk::Buffer &source, VkDeviceSize firstPixel,
+                                            uint32_t vec4PerPixel) {
+  SCOPED_TIMER(__FUNCTION__);
+  const VkExtent2D size = m_gBuffers.getSize();
+  const size_t pixelCount = static_cast<size_t>(size.width) * size.height;
+  const VkDeviceSize pixelBytes = vec4PerPixel * sizeof(glm::vec4);
+
+  nvvk::Buffer readback;
+  NVVK_CHECK(m_allocator.createBuffer(readback, pixelCount * pixelBytes,
+                                      VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                      VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                          VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT));
+  NVVK_DBG_NAME(readback.buffer);
+
+  VkCommandBuffer cmd = m_app->createTempCmdBuffer();
+  cmdAccumulationBarrier(cmd, m_traceStages);
+  const VkBufferCopy region{.srcOffset = firstPixel * pixelBytes, .size = pixelCount * pixelBytes};
+  vkCmdCopyBuffer(cmd, source.buffer, readback.buffer, 1, &region);
+  m_app->submitAndWaitTempCmdBuffer(cmd);
+  NVVK_CHECK(vmaInvalidateAllocation(m_allocator, readback.allocation, 0, VK_WHOLE_SIZE));
+
+  const auto *pixels = static_cast<const glm::vec4 *>(readback.mapping);
+  std::vector<float> rgb(pixelCount * 3);
+  for (size_t i = 0; i < pixelCount; ++i) {
+    rgb[i * 3 + 0] = pixels[i * vec4PerPixel].x;
+    rgb[i * 3 + 1] = pixels[i * vec4PerPixel].y;
+    rgb[i * 3 + 2] = pixels[i * vec4PerPixel].z;
+  }
+  m_allocator.destroyBuffer(readback);
+  return rgb;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Writes a float image, and reports its difference to --reference if given.
+//
+void Raytracer::saveImage(const std::filesystem::path &path, const std::vector<float> &rgb) {
+  SCOPED_TIMER(__FUNCTION__);
+  const VkExtent2D size = m_gBuffers.getSize();
+  writeImage(path, size.width, size.height, rgb);
+  printf("[Offline] wrote %s\n", path.string().c_str());
+
+  if (!m_settings.referencePath.empty()) {
+    // Bias of the approximations (density LOD, estimators) against a converged render
+    const Image reference = readImage(m_settings.referencePath);
+    if (reference.width != size.width || reference.height != size.height) {
+      throw std::runtime_error("Reference image " + m_settings.referencePath.string() +
+                               " does not match the render size");
+    }
+    const ImageDifference diff = compareImages(rgb, reference.rgb);
+    printf("[Offline] vs reference %s: relative bias %+.4f%%, RMSE %.5f, relMSE %.5f\n",
+           m_settings.referencePath.string().c_str(), diff.relativeBias * 100.0, diff.rmse,
+           diff.relativeMse);
+  }
 }
 
 void Raytracer::createResources() {
@@ -433,6 +1332,17 @@ void Raytracer::createResources() {
                                       VMA_MEMORY_USAGE_AUTO));
   NVVK_DBG_NAME(m_bSceneInfo.buffer);
 
+  // Converged-pixel counters, read back on the host without waiting
+  m_allocator.destroyBuffer(m_bConvergence);
+  NVVK_CHECK(m_allocator.createBuffer(m_bConvergence, kConvergenceSlots * sizeof(uint32_t),
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                      VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                          VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT));
+  NVVK_DBG_NAME(m_bConvergence.buffer);
+  m_convergenceEpoch.fill(0);
+
   assert(m_stagingUploader.isAppendedEmpty());
   VkCommandBuffer cmd = m_app->createTempCmdBuffer();
   m_stagingUploader.cmdUploadAppended(cmd);
@@ -440,6 +1350,177 @@ void Raytracer::createResources() {
   m_stagingUploader.releaseStaging();
 }
 
+//---------------------------------------------------------------------------------------------------------------
+// fp32 accumulation buffer: running mean and luminance moments, two vec4 per pixel.
+// The shader restarts it on the first frame, so it does not need clearing.
+//
+void Raytracer::createAccumBuffer(const VkExtent2D &size) {
+  const VkDeviceSize byteSize =
+      std::max<VkDeviceSize>(static_cast<VkDeviceSize>(size.width) * size.height, 1) * 2 *
+      sizeof(glm::vec4);
+  if (m_bAccum.buffer != VK_NULL_HANDLE) {
+    // Still referenced by the frames in flight
+    m_app->submitResourceFree([this, buffer = m_bAccum]() mutable {
+      m_allocator.destroyBuffer(buffer);
+    });
+    m_bAccum = {};
+  }
+  NVVK_CHECK(m_allocator.createBuffer(m_bAccum, byteSize,
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_TRANSFER_SRC_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bAccum.buffer);
+
+  if (m_bHistory.buffer != VK_NULL_HANDLE) {
+    m_app->submitResourceFree([this, buffer = m_bHistory]() mutable {
+      m_allocator.destroyBuffer(buffer);
+    });
+    m_bHistory = {};
+  }
+  NVVK_CHECK(m_allocator.createBuffer(m_bHistory, byteSize,
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bHistory.buffer);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Chooses the samples per pixel of the next interactive frame from the GPU trace time
+// of recent frames, so that the trace takes about the frame budget: the interactive
+// one while the image keeps restarting, the idle one once it has accumulated for a
+// second. When one sample per pixel is over budget, the next restart splits the image
+// into bands of rows traced one per frame (see tileRows in renderer.slang). Pixels
+// keep a running mean over their samples, so frames of any sample count combine with
+// equal weight per sample.
+//
+void Raytracer::scheduleFrame() {
+  if (m_settings.frameBudgetMs <= 0.0f || !m_profiler.enabled() || m_profiler.history().empty()) {
+    m_scheduledTiles = 1;
+    return;
+  }
+  // Timestamps resolve a few frames late; fold each resolved frame in once
+  const FrameProfiler::FrameStats &last = m_profiler.history().back();
+  if (last.frame != m_costStatsFrame && last.pathsPerSecond > 0.0) {
+    const double costMs = 1e3 / last.pathsPerSecond;
+    m_pathCostMs = m_pathCostMs > 0.0 ? m_pathCostMs + 0.25 * (costMs - m_pathCostMs) : costMs;
+    m_costStatsFrame = last.frame;
+  }
+  if (m_pathCostMs <= 0.0) {
+    return;
+  }
+
+  const VkExtent2D &size = m_app->getViewportSize();
+  const double pixels = std::max(static_cast<double>(size.width) * size.height, 1.0);
+  const double interactiveSpp = m_settings.frameBudgetMs / (m_pathCostMs * pixels);
+  m_scheduledTiles = m_settings.tiledFrames && interactiveSpp < 1.0
+                         ? static_cast<uint32_t>(std::min(std::ceil(1.0 / interactiveSpp),
+                                                          static_cast<double>(kMaxFrameTiles)))
+                         : 1;
+
+  const bool restart = restartPending();
+  const bool idle =
+      !restart && std::chrono::steady_clock::now() - m_lastRestart >= std::chrono::seconds(1);
+  double spp = interactiveSpp;
+  if (idle) {
+    spp = m_settings.idleFrameBudgetMs > 0.0f
+              ? m_settings.idleFrameBudgetMs / (m_pathCostMs * pixels)
+              : static_cast<double>(kMaxFrameSpp);
+  }
+  // Budgets are per frame, which only traces one band when tiled
+  spp *= restart ? m_scheduledTiles : m_sceneInfo.tileCount;
+  m_sceneInfo.sampleCount = static_cast<unsigned int>(
+      std::clamp(std::floor(spp), 1.0, static_cast<double>(kMaxFrameSpp)));
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Snapshot of the accumulation for the reprojecting frame, which restarts m_bAccum and
+// reads the previous image from m_bHistory.
+//
+void Raytracer::cmdCopyHistory(VkCommandBuffer cmd) {
+  NVVK_DBG_SCOPE(cmd);
+  cmdAccumulationBarrier(cmd, m_traceStages);
+  const VkBufferCopy region{.size = m_bAccum.bufferSize};
+  vkCmdCopyBuffer(cmd, m_bAccum.buffer, m_bHistory.buffer, 1, &region);
+  nvvk::cmdBufferMemoryBarrier(cmd, {m_bHistory.buffer,
+                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                     m_traceStages});
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Reservoirs of resampled direct lighting: two vec4 per pixel, for this frame and the
+// previous one. Cleared on creation and on every accumulation restart (see
+// clearReservoirs), so reuse never reads a reservoir of another scene or view.
+//
+void Raytracer::createReservoirBuffer(VkCommandBuffer cmd, const VkExtent2D &size) {
+  const VkDeviceSize byteSize =
+      std::max<VkDeviceSize>(static_cast<VkDeviceSize>(size.width) * size.height, 1) * 2 * 2 *
+      sizeof(glm::vec4);
+  if (m_bReservoirs.buffer != VK_NULL_HANDLE) {
+    m_app->submitResourceFree([this, buffer = m_bReservoirs]() mutable {
+      m_allocator.destroyBuffer(buffer);
+    });
+    m_bReservoirs = {};
+  }
+  NVVK_CHECK(m_allocator.createBuffer(m_bReservoirs, byteSize,
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_TRANSFER_DST_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bReservoirs.buffer);
+  clearReservoirs(cmd);
+}
+
+// All zero is an empty reservoir (M = 0), which reuse skips.
+void Raytracer::clearReservoirs(VkCommandBuffer cmd) {
+  nvvk::cmdBufferMemoryBarrier(cmd, {m_bReservoirs.buffer,
+                                     m_traceStages,
+                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT});
+  vkCmdFillBuffer(cmd, m_bReservoirs.buffer, 0, VK_WHOLE_SIZE, 0);
+  nvvk::cmdBufferMemoryBarrier(cmd, {m_bReservoirs.buffer,
+                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                     m_traceStages});
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Denoiser inputs and ping-pong: the AOVs restart with the accumulation, so neither
+// needs clearing. The ping-pong is read back for the offline output.
+//
+void Raytracer::createDenoiseBuffers(const VkExtent2D &size) {
+  const VkDeviceSize byteSize =
+      std::max<VkDeviceSize>(static_cast<VkDeviceSize>(size.width) * size.height, 1) * 2 *
+      sizeof(glm::vec4);
+  if (m_bAov.buffer != VK_NULL_HANDLE) {
+    m_app->submitResourceFree([this, aov = m_bAov, pingPong = m_bDenoise]() mutable {
+      m_allocator.destroyBuffer(aov);
+      m_allocator.destroyBuffer(pingPong);
+    });
+    m_bAov = {};
+    m_bDenoise = {};
+  }
+  NVVK_CHECK(m_allocator.createBuffer(m_bAov, byteSize, VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bAov.buffer);
+  NVVK_CHECK(m_allocator.createBuffer(m_bDenoise, byteSize,
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_TRANSFER_SRC_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bDenoise.buffer);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Transmittance cache: three vec4 of L1 spherical harmonics (R, G, B) per cell. It is
+// allocated even while the cache is off, as the UI can turn it on at any time.
+//
+void Raytracer::createTransmittanceCache() {
+  const uint32_t res = m_settings.transmittanceCacheRes;
+  const VkDeviceSize byteSize = static_cast<VkDeviceSize>(res) * res * res * 3 * sizeof(glm::vec4);
+  NVVK_CHECK(m_allocator.createBuffer(m_bTransmittanceCache, byteSize,
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bTransmittanceCache.buffer);
+  m_sceneInfo.transmittanceCacheRes = res;
+  invalidateTransmittanceCache();
+}
+
 void Raytracer::createRaytraceDescriptorLayout() {
   SCOPED_TIMER(__FUNCTION__);
   nvvk::DescriptorBindings bindings;
@@ -463,82 +1544,468 @@ void Raytracer::createRaytraceDescriptorLayout() {
                       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                       .descriptorCount = 1,
                       .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eMajorantGrid,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eEnvDistribution,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eAccumBuffer,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eConvergence,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  // Wavefront path state and queues; only written while that backend is active
+  for (uint32_t binding : {shaderio::BindingIndex::eWavefrontPaths,
+                           shaderio::BindingIndex::eWavefrontQueues,
+                           shaderio::BindingIndex::eWavefrontCounters}) {
+    bindings.addBinding({.binding = binding,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_ALL});
+  }
+  bindings.addBinding({.binding = shaderio::BindingIndex::eVolumeInstances,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eLights,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eReservoirs,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eHistoryBuffer,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eAovBuffer,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eDenoiseBuffer,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  bindings.addBinding({.binding = shaderio::BindingIndex::eTransmittanceCache,
+                      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                      .descriptorCount = 1,
+                      .stageFlags = VK_SHADER_STAGE_ALL});
+  if (m_useRayQuery) {
+    bindings.addBinding({.binding = shaderio::BindingIndex::eTopLevelAS,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_ALL});
+  }
   // Creating a PUSH descriptor set and set layout from the bindings
   m_rtDescPack.init(bindings, m_app->getDevice(), 0,
                     VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
 }
 
-void Raytracer::createRayTracingPipeline() {
+void Raytracer::createPipelineLayout() {
   SCOPED_TIMER(__FUNCTION__);
-  // For re-creation
-  vkDestroyPipeline(m_app->getDevice(), m_rtPipeline, nullptr);
   vkDestroyPipelineLayout(m_app->getDevice(), m_rtPipelineLayout, nullptr);
 
-  // Creating all shaders
-  enum { eRaygen, eShaderGroupCount };
-  std::array<VkPipelineShaderStageCreateInfo, eShaderGroupCount> stages{};
-  for (auto &s : stages)
-    s.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-
-  // Use the embedded SPIR-V generated by compile_slang.
-  VkShaderModuleCreateInfo shaderCode{
-      VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-  shaderCode.codeSize = renderer_slang_sizeInBytes;
-  shaderCode.pCode = renderer_slang;
-
-  stages[eRaygen].pNext = &shaderCode;
-  stages[eRaygen].pName = "rgenMain";
-  stages[eRaygen].stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-
-  // Shader groups
-  VkRayTracingShaderGroupCreateInfoKHR group{
-      VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
-  group.anyHitShader = VK_SHADER_UNUSED_KHR;
-  group.closestHitShader = VK_SHADER_UNUSED_KHR;
-  group.generalShader = VK_SHADER_UNUSED_KHR;
-  group.intersectionShader = VK_SHADER_UNUSED_KHR;
-
-  std::vector<VkRayTracingShaderGroupCreateInfoKHR> shader_groups;
-  // Raygen
-  group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-  group.generalShader = eRaygen;
-  shader_groups.push_back(group);
-
-  // // Push constant: we want to be able to update constants used by the
-  // shaders const VkPushConstantRange push_constant{VK_SHADER_STAGE_ALL, 0,
-  //                                         sizeof(shaderio::TutoPushConstant)};
+  // Push constant: per-stage parameters of the wavefront kernels
+  const VkPushConstantRange push_constant{VK_SHADER_STAGE_ALL, 0,
+                                          sizeof(shaderio::WavefrontPushConstant)};
 
   VkPipelineLayoutCreateInfo pipeline_layout_create_info{
       VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-  // pipeline_layout_create_info.pushConstantRangeCount = 1;
-  // pipeline_layout_create_info.pPushConstantRanges = &push_constant;
+  pipeline_layout_create_info.pushConstantRangeCount = 1;
+  pipeline_layout_create_info.pPushConstantRanges = &push_constant;
 
-  // Descriptor sets: one specific to ray tracing, and one shared with the
-  // rasterization pipeline
+  // One push descriptor set, shared by the ray tracing and compute pipelines
   std::array<VkDescriptorSetLayout, 1> layouts = {{m_rtDescPack.getLayout()}};
   pipeline_layout_create_info.setLayoutCount = uint32_t(layouts.size());
   pipeline_layout_create_info.pSetLayouts = layouts.data();
-  vkCreatePipelineLayout(m_app->getDevice(), &pipeline_layout_create_info,
-                         nullptr, &m_rtPipelineLayout);
+  NVVK_CHECK(vkCreatePipelineLayout(m_app->getDevice(), &pipeline_layout_create_info,
+                                    nullptr, &m_rtPipelineLayout));
   NVVK_DBG_NAME(m_rtPipelineLayout);
+}
+
+// The ray-query variants of the renderer when the scene gets a TLAS, see loadScene.
+Raytracer::RendererSpirv Raytracer::rendererSpirv() const {
+  RendererSpirv spirv;
+  if (m_useRayQuery) {
+    spirv.compute = embeddedSpirv(renderer_compute_rayquery_slang,
+                                  renderer_compute_rayquery_slang_sizeInBytes);
+    if (m_rayTracingSupported) {
+      spirv.rayTracing = embeddedSpirv(renderer_rayquery_slang, renderer_rayquery_slang_sizeInBytes);
+    }
+  } else {
+    spirv.compute = embeddedSpirv(renderer_compute_slang, renderer_compute_slang_sizeInBytes);
+    if (m_rayTracingSupported) {
+      spirv.rayTracing = embeddedSpirv(renderer_slang, renderer_slang_sizeInBytes);
+    }
+  }
+  return spirv;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Every pipeline of the renderer modules for one variant: the single-raygen ray
+// tracing pipeline (when supported), the compute variants of the integrator and the
+// wavefront stages. All of them are built up front so the backend can be switched from the UI.
+//
+// Only touches the device, the pipeline layout and the pipeline cache, so shader hot
+// reload and background variant builds call it from their own threads while frames
+// keep rendering.
+//
+Raytracer::PipelineSet Raytracer::createPipelines(const RendererSpirv &spirv,
+                                                  const PipelineVariant &variant) const {
+  SCOPED_TIMER(__FUNCTION__);
+  const VkDevice device = m_app->getDevice();
+  const VkPipelineCache cache = m_pipelineCache.handle();
+  PipelineSet pipelines;
+
+  // In renderer.slang constant_id order; bools are VkBool32
+  const std::array<uint32_t, 4> constants = {
+      static_cast<uint32_t>(variant.maxScatterDepth),
+      static_cast<uint32_t>(variant.russianRouletteDepth),
+      variant.isotropic ? VK_TRUE : VK_FALSE,
+      variant.nonAbsorbing ? VK_TRUE : VK_FALSE,
+  };
+  std::array<VkSpecializationMapEntry, 4> entries{};
+  for (uint32_t i = 0; i < entries.size(); ++i) {
+    entries[i] = {.constantID = i, .offset = i * uint32_t(sizeof(uint32_t)), .size = sizeof(uint32_t)};
+  }
+  const VkSpecializationInfo specialization{
+      .mapEntryCount = static_cast<uint32_t>(entries.size()),
+      .pMapEntries = entries.data(),
+      .dataSize = sizeof(constants),
+      .pData = constants.data(),
+  };
+
+  if (m_rayTracingSupported) {
+    const VkShaderModuleCreateInfo rayTracingCode = shaderModuleInfo(spirv.rayTracing);
+    const RayTracingPipelineDesc desc(&rayTracingCode, m_rtPipelineLayout, &specialization);
+    NVVK_CHECK(vkCreateRayTracingPipelinesKHR(device, {}, cache, 1, &desc.info, nullptr,
+                                              &pipelines.rayTracing));
+    NVVK_DBG_NAME(pipelines.rayTracing);
+  }
+
+  const VkShaderModuleCreateInfo computeCode = shaderModuleInfo(spirv.compute);
+  const auto createPipeline = [&](const char *entryPoint, VkPipeline &pipeline) {
+    const VkComputePipelineCreateInfo pipelineInfo{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                  .pNext = &computeCode,
+                  .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                  .pName = entryPoint,
+                  .pSpecializationInfo = &specialization},
+        .layout = m_rtPipelineLayout,
+    };
+    NVVK_CHECK(vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline));
+    NVVK_DBG_NAME(pipeline);
+  };
+
+  const std::array<const char *, 2> entryPoints = {"compMain", "compMainMorton"};
+  for (size_t i = 0; i < entryPoints.size(); ++i) {
+    createPipeline(entryPoints[i], pipelines.compute[i]);
+  }
+
+  // Wavefront stages, in WavefrontStage order
+  const std::array<const char *, eWfStageCount> wavefrontEntryPoints = {
+      "wfPrepare", "wfGenerate", "wfDistance", "wfSortHistogram", "wfSortScan",
+      "wfSortScatter", "wfShadow", "wfShade", "wfMiss", "wfResolve"};
+  for (size_t i = 0; i < wavefrontEntryPoints.size(); ++i) {
+    createPipeline(wavefrontEntryPoints[i], pipelines.wavefront[i]);
+  }
+  createPipeline("denoiseAtrous", pipelines.denoise);
+  createPipeline("previewMarch", pipelines.preview);
+  createPipeline("buildTransmittanceCache", pipelines.transmittanceCache);
+  return pipelines;
+}
+
+void Raytracer::destroyPipelines(PipelineSet &pipelines) const {
+  const VkDevice device = m_app->getDevice();
+  vkDestroyPipeline(device, pipelines.rayTracing, nullptr);
+  for (VkPipeline pipeline : pipelines.compute) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+  }
+  for (VkPipeline pipeline : pipelines.wavefront) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+  }
+  vkDestroyPipeline(device, pipelines.denoise, nullptr);
+  vkDestroyPipeline(device, pipelines.preview, nullptr);
+  vkDestroyPipeline(device, pipelines.transmittanceCache, nullptr);
+  pipelines = {};
+}
+
+// Drops every cached variant and the SBT; the frames in flight may still use them,
+// so they are freed once those retire.
+void Raytracer::retireVariants() {
+  m_app->submitResourceFree([this, variants = m_variants, sbt = m_sbtBuffer]() mutable {
+    for (auto &[variant, pipelines] : variants) {
+      destroyPipelines(pipelines);
+    }
+    m_allocator.destroyBuffer(sbt);
+  });
+  m_variants.clear();
+  m_sbtBuffer = {};
+  m_pipelines = {};
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Pipeline variants: the tightest kernel for the current scene, built on demand and
+// cached. Every variant computes the same image, so switching keeps the accumulation.
+//
+std::string Raytracer::PipelineVariant::label() const {
+  if (*this == PipelineVariant{}) {
+    return "generic";
+  }
+  std::string label =
+      "depth " + std::to_string(maxScatterDepth) + ", rr " + std::to_string(russianRouletteDepth);
+  if (isotropic) {
+    label += ", isotropic";
+  }
+  if (nonAbsorbing) {
+    label += ", no absorption";
+  }
+  return label;
+}
+
+Raytracer::PipelineVariant Raytracer::sceneVariant() const {
+  PipelineVariant variant;
+  if (!m_settings.specializePipelines) {
+    return variant;
+  }
+  // Values the generic variant would read anyway map to its defaults
+  variant.maxScatterDepth = std::max(m_sceneInfo.maxScatterDepth, 0);
+  variant.russianRouletteDepth = std::max(m_sceneInfo.russianRouletteDepth, -1);
+  variant.isotropic = true;
+  variant.nonAbsorbing = true;
+  for (const shaderio::VolumeInstance &instance : m_instances) {
+    const float g = (instance.flags & shaderio::kVolumeInstanceOverrideG) != 0 ? instance.g : m_hgG;
+    variant.isotropic = variant.isotropic && g == 0.0f;
+    variant.nonAbsorbing =
+        variant.nonAbsorbing && m_volumeDesc.sigma_a * instance.sigma_a == glm::vec3(0.0f);
+  }
+  return variant;
+}
+
+// Called at the start of a frame: collects a finished background build, starts the
+// next one, and binds the scene's variant when it exists (the generic one otherwise).
+void Raytracer::selectPipelineVariant() {
+  if (m_variantBuild.valid() &&
+      m_variantBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    PipelineSet pipelines = m_variantBuild.get();
+    if (m_variantBuildGeneration == m_shaderGeneration) {
+      m_variants.emplace(m_variantBuildKey, pipelines);
+      m_pipelineCache.save();
+    } else {
+      destroyPipelines(pipelines);  // built from code a hot reload replaced, never bound
+    }
+  }
+
+  const PipelineVariant wanted = sceneVariant();
+  if (!m_variants.contains(wanted)) {
+    if (m_settings.headless) {
+      // Offline renders never change the scene: build it before the first dispatch
+      m_variants.emplace(wanted, createPipelines(m_spirv, wanted));
+      printf("[Variants] built %s\n", wanted.label().c_str());
+    } else if (!m_variantBuild.valid()) {
+      m_variantBuildKey = wanted;
+      m_variantBuildGeneration = m_shaderGeneration;
+      m_variantBuild = std::async(std::launch::async, [this, spirv = m_spirv, wanted] {
+        return createPipelines(spirv, wanted);
+      });
+    }
+  }
+
+  const bool specialized = m_variants.contains(wanted);
+  const PipelineVariant bind = specialized ? wanted : PipelineVariant{};
+  if (bind != m_boundVariant || m_pipelines.compute[0] == VK_NULL_HANDLE) {
+    bindPipelineVariant(bind);
+  }
+
+  const uint32_t index =
+      m_variantIds.try_emplace(wanted, static_cast<uint32_t>(m_variantIds.size())).first->second;
+  m_statsVariant = index * 2 + (specialized && wanted != PipelineVariant{} ? 1 : 0);
+}
+
+// Makes a cached variant current. The SBT holds the pipeline's shader handles, so it is
+// rebuilt; the previous one is freed once the frames in flight are done with it.
+void Raytracer::bindPipelineVariant(const PipelineVariant &variant) {
+  if (m_sbtBuffer.buffer != VK_NULL_HANDLE) {
+    m_app->submitResourceFree([this, sbt = m_sbtBuffer]() mutable { m_allocator.destroyBuffer(sbt); });
+    m_sbtBuffer = {};
+  }
+  m_pipelines = m_variants.at(variant);
+  m_boundVariant = variant;
+
+  if (m_pipelines.rayTracing != VK_NULL_HANDLE) {
+    const RayTracingPipelineDesc desc(nullptr, m_rtPipelineLayout);
+    createShaderBindingTable(desc.info);
+  }
+}
+
+// GPU throughput of each scene variant seen so far, with the generic kernel and with
+// its specialized one (untick "Specialize" to measure the generic one).
+void Raytracer::variantsUI() {
+  if (!ImGui::CollapsingHeader("Pipeline variants")) {
+    return;
+  }
+  ImGui::Checkbox("Specialize", &m_settings.specializePipelines);
+  ImGui::TextWrapped("Bound: %s", m_boundVariant.label().c_str());
+  if (m_variantBuild.valid()) {
+    ImGui::TextDisabled("Building %s...", m_variantBuildKey.label().c_str());
+  }
+
+  const auto &totals = m_profiler.variantTotals();
+  const auto mpathsPerSecond = [&totals](uint32_t id) {
+    const auto it = totals.find(id);
+    return it == totals.end() || it->second.traceMs <= 0.0
+               ? 0.0
+               : it->second.samples / (it->second.traceMs * 1e-3) * 1e-6;
+  };
+  for (const auto &[variant, index] : m_variantIds) {
+    if (variant == PipelineVariant{}) {
+      continue;
+    }
+    const double generic = mpathsPerSecond(index * 2);
+    const double specialized = mpathsPerSecond(index * 2 + 1);
+    ImGui::Text("%s", variant.label().c_str());
+    if (generic > 0.0 && specialized > 0.0) {
+      ImGui::Text("  %.2f -> %.2f Mpaths/s  (%.2fx)", generic, specialized, specialized / generic);
+    } else {
+      ImGui::Text("  generic %.2f, specialized %.2f Mpaths/s", generic, specialized);
+    }
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Shader hot reload
+//
+std::filesystem::path Raytracer::findShaderDirectory() const {
+  for (const std::filesystem::path &dir : peacock::getShaderDirs()) {
+    std::error_code error;
+    if (std::filesystem::is_regular_file(dir / "renderer.slang", error)) {
+      return dir;
+    }
+  }
+  return {};
+}
+
+// Runs on the worker thread of m_shaderReloader. A failed compile keeps the running
+// pipelines; the error is reported by the Slang compiler. Only the generic variant is
+// built here, the specialized ones follow on demand.
+bool Raytracer::rebuildShaders() {
+  const auto start = std::chrono::steady_clock::now();
+  const char *computeSource =
+      m_useRayQuery ? "renderer_compute_rayquery.slang" : "renderer_compute.slang";
+  const char *rayTracingSource = m_useRayQuery ? "renderer_rayquery.slang" : "renderer.slang";
+  const auto compile = [&](const char *source, std::vector<uint32_t> &spirv) {
+    if (!m_slangCompiler.compileFile(m_shaderReloader.directory() / source)) {
+      printf("[Shaders] %s failed to compile, keeping the current pipelines\n", source);
+      return false;
+    }
+    spirv.assign(m_slangCompiler.getSpirv(),
+                 m_slangCompiler.getSpirv() + m_slangCompiler.getSpirvSize() / sizeof(uint32_t));
+    return true;
+  };
+
+  PendingShaders shaders;
+  if (!compile(computeSource, shaders.spirv.compute) ||
+      (m_rayTracingSupported && !compile(rayTracingSource, shaders.spirv.rayTracing))) {
+    return false;
+  }
+  shaders.pipelines = createPipelines(shaders.spirv, PipelineVariant{});
+  {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    if (m_pendingShaders) {
+      // Superseded before the render loop took it; never bound
+      destroyPipelines(m_pendingShaders->pipelines);
+    }
+    m_pendingShaders = std::move(shaders);
+  }
 
-  // Assemble the shader stages and recursion depth info into the ray tracing
-  // pipeline
-  VkRayTracingPipelineCreateInfoKHR rtPipelineInfo{
-      VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
-  rtPipelineInfo.stageCount =
-      static_cast<uint32_t>(stages.size()); // Stages are shaders
-  rtPipelineInfo.pStages = stages.data();
-  rtPipelineInfo.groupCount = static_cast<uint32_t>(shader_groups.size());
-  rtPipelineInfo.pGroups = shader_groups.data();
-  rtPipelineInfo.maxPipelineRayRecursionDepth = 1;
-  rtPipelineInfo.layout = m_rtPipelineLayout;
-  vkCreateRayTracingPipelinesKHR(m_app->getDevice(), {}, {}, 1, &rtPipelineInfo,
-                                 nullptr, &m_rtPipeline);
-  NVVK_DBG_NAME(m_rtPipeline);
-
-  // Create the shader binding table for this pipeline
-  createShaderBindingTable(rtPipelineInfo);
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("[Shaders] rebuilt the renderer in %.2f s\n", seconds);
+  return true;
+}
+
+// Called at the start of a frame: swaps in the code published by rebuildShaders.
+void Raytracer::installPendingPipelines() {
+  std::optional<PendingShaders> shaders;
+  {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    shaders.swap(m_pendingShaders);
+  }
+  if (!shaders) {
+    return;
+  }
+  retireVariants();
+  m_spirv = std::move(shaders->spirv);
+  ++m_shaderGeneration;
+  m_variants.emplace(PipelineVariant{}, shaders->pipelines);
+  bindPipelineVariant(PipelineVariant{});
+  m_sceneInfo.frameIndex = 0;
+  m_pipelineCache.save();
+}
+
+void Raytracer::shadersUI() {
+  if (!ImGui::CollapsingHeader("Shaders")) {
+    return;
+  }
+  if (!m_shaderReloader.running()) {
+    ImGui::TextDisabled("Hot reload off");
+    return;
+  }
+  ImGui::TextWrapped("Watching %s", m_shaderReloader.directory().string().c_str());
+  ImGui::LabelText("Reloads", "%u", m_shaderReloader.rebuildCount());
+  if (m_shaderReloader.lastRebuildFailed()) {
+    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "Last rebuild failed, see the log");
+  }
+  if (ImGui::Button("Reload shaders")) {
+    m_shaderReloader.requestRebuild();
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Path state and queues of the wavefront backend: one path per pixel.
+//
+void Raytracer::createWavefrontBuffers(const VkExtent2D &size) {
+  if (m_bWavefrontPaths.buffer != VK_NULL_HANDLE) {
+    // Still referenced by the frames in flight
+    m_app->submitResourceFree(
+        [this, paths = m_bWavefrontPaths, queues = m_bWavefrontQueues,
+         counters = m_bWavefrontCounters]() mutable {
+          m_allocator.destroyBuffer(paths);
+          m_allocator.destroyBuffer(queues);
+          m_allocator.destroyBuffer(counters);
+        });
+    m_bWavefrontPaths = {};
+    m_bWavefrontQueues = {};
+    m_bWavefrontCounters = {};
+  }
+
+  const VkDeviceSize pathCount =
+      std::max<VkDeviceSize>(static_cast<VkDeviceSize>(size.width) * size.height, 1);
+  NVVK_CHECK(m_allocator.createBuffer(m_bWavefrontPaths,
+                                      pathCount * shaderio::eFieldCount * sizeof(glm::vec4),
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bWavefrontPaths.buffer);
+  NVVK_CHECK(m_allocator.createBuffer(m_bWavefrontQueues,
+                                      pathCount * shaderio::eQueueCount * sizeof(uint32_t),
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bWavefrontQueues.buffer);
+  NVVK_CHECK(m_allocator.createBuffer(m_bWavefrontCounters,
+                                      shaderio::kWavefrontCounterCount * sizeof(uint32_t),
+                                      VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_2_INDIRECT_BUFFER_BIT,
+                                      VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE));
+  NVVK_DBG_NAME(m_bWavefrontCounters.buffer);
+  m_wavefrontSize = size;
 }
 
 void Raytracer::createShaderBindingTable(
@@ -548,7 +2015,7 @@ void Raytracer::createShaderBindingTable(
   m_allocator.destroyBuffer(m_sbtBuffer); // Cleanup when re-creating
   // Calculate required SBT buffer size
   size_t bufferSize =
-      m_sbtGenerator.calculateSBTBufferSize(m_rtPipeline, rtPipelineInfo);
+      m_sbtGenerator.calculateSBTBufferSize(m_pipelines.rayTracing, rtPipelineInfo);
   assert(bufferSize > 0 && "SBT buffer size is zero. Check pipeline groups and "
                            "SBT generator initialization.");
 
@@ -572,77 +2039,422 @@ void Raytracer::createShaderBindingTable(
 //---------------------------------------------------------------------------------------------------------------
 // The update of scene information buffer (UBO)
 //
-void Raytracer::updateSceneBuffer(VkCommandBuffer cmd) {
+void Raytracer::updateSceneBuffer(VkCommandBuffer cmd, bool countConverged) {
   NVVK_DBG_SCOPE(cmd); // <-- Helps to debug in NSight
+  m_profiler.begin(cmd, FrameProfiler::eSceneUpdate);
   const glm::mat4 &viewMatrix = m_cameraManip->getViewMatrix();
   const glm::mat4 &projMatrix = m_cameraManip->getPerspectiveMatrix();
+  const glm::mat4 prevViewProjMatrix = m_sceneInfo.viewProjMatrix;
+  const glm::vec3 prevCameraPosition = m_sceneInfo.cameraPosition;
 
   m_sceneInfo.viewProjMatrix = projMatrix * viewMatrix;
   m_sceneInfo.projInvMatrix = glm::inverse(m_cameraManip->getPerspectiveMatrix());
   m_sceneInfo.viewInvMatrix = glm::inverse(m_cameraManip->getViewMatrix());
   m_sceneInfo.cameraPosition = m_cameraManip->getEye();
-  m_sceneInfo.useSky = 0;
 
-  // Reset accumulation when the camera moves
-  if (m_sceneInfo.viewInvMatrix != m_prevViewMatrix) {
+  // Reset accumulation when the camera moves. With reprojection the restarted frame
+  // (every band's first visit when tiled) also merges the previous image, unless
+  // something else reset it this frame or a band has not been traced from the
+  // previous view yet. After a preview, the previous image is the one accumulated
+  // before it.
+  bool reproject = false;
+  if (m_previewHistory && !m_previewShown) {
+    cmdCopyHistory(cmd);
+    reproject = true;
+    m_sceneInfo.prevViewProjMatrix = m_previewViewProjMatrix;
+    m_sceneInfo.prevCameraPosition = m_previewCameraPosition;
+    ++m_sceneInfo.motionFrames;
+    m_previewHistory = false;
+    m_sceneInfo.frameIndex = 0;
+    m_prevViewMatrix = m_sceneInfo.viewInvMatrix;
+  } else if (m_sceneInfo.viewInvMatrix != m_prevViewMatrix) {
+    if (m_settings.reproject && historyComplete() && !m_previewShown) {
+      cmdCopyHistory(cmd);
+      reproject = true;
+      m_sceneInfo.prevViewProjMatrix = prevViewProjMatrix;
+      m_sceneInfo.prevCameraPosition = prevCameraPosition;
+      ++m_sceneInfo.motionFrames;
+    }
     m_sceneInfo.frameIndex = 0;
     m_prevViewMatrix = m_sceneInfo.viewInvMatrix;
   }
 
   m_sceneInfo.frameIndex++;
+  if (m_sceneInfo.frameIndex == 1) {
+    // Counts recorded before the restart describe a different image
+    ++m_accumEpoch;
+    m_convergedFraction = 0.0f;
+    m_converged = false;
+    // The band count holds until the next restart, so each band restarts on its first visit
+    m_sceneInfo.tileCount = m_scheduledTiles;
+    m_tileConverged.assign(m_sceneInfo.tileCount, 0);
+    m_sceneInfo.reprojectHistory = reproject ? 1u : 0u;
+    m_lastRestart = std::chrono::steady_clock::now();
+    if (m_sceneInfo.risCandidates > 0 && m_sceneInfo.risReuse != 0) {
+      clearReservoirs(cmd);
+    }
+  }
+  // The band cursor survives restarts: while the camera keeps moving every frame
+  // restarts, and the bands must keep rotating rather than retrace the first one.
+  // Bands are still visited in turn, so a band's visit count follows frameIndex.
+  m_sceneInfo.tileIndex = m_tileCursor++ % m_sceneInfo.tileCount;
+  m_sceneInfo.tileVisit = (m_sceneInfo.frameIndex - 1) / m_sceneInfo.tileCount;
+  if (m_sceneInfo.tileVisit > 0) {
+    m_sceneInfo.reprojectHistory = 0;
+  }
+  m_sceneInfo.noiseThreshold = m_settings.noiseThreshold;
+  m_sceneInfo.adaptiveMinSamples = m_settings.adaptiveMinSpp;
+  m_sceneInfo.countConverged = countConverged ? 1u : 0u;
+  if (countConverged) {
+    prepareConvergenceCounter(cmd);
+  }
+
   // Sync HG anisotropy (may change from UI) into VolumeDesc
   m_volumeDesc.g = m_hgG;
 
+  // Shadow rays only read the transmittance cache once every slab is built; a new
+  // build spans the current scene bounds.
+  m_sceneInfo.transmittanceCacheDepth = m_transmittanceCacheReady ? m_settings.transmittanceCacheDepth : 0u;
+  if (m_transmittanceCacheCursor == 0) {
+    m_sceneInfo.transmittanceCacheMin = m_volumeDesc.bboxMin;
+    m_sceneInfo.transmittanceCacheMax = m_volumeDesc.bboxMax;
+  }
+
   // Making sure the scene information buffer is updated before rendering
   // Wait that the fragment shader is done reading the previous scene
   // information and wait for the transfer to complete
   nvvk::cmdBufferMemoryBarrier(cmd, {m_bSceneInfo.buffer,
-                                     VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                     m_traceStages,
                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT});
   vkCmdUpdateBuffer(cmd, m_bSceneInfo.buffer, 0, sizeof(shaderio::SceneInfo),
                     &m_sceneInfo);
   nvvk::cmdBufferMemoryBarrier(cmd, {m_bSceneInfo.buffer,
                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                     VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR});
+                                     m_traceStages});
 
   // Also keep VolumeDesc buffer in sync (densityScale / sigmaMax may change from UI)
   nvvk::cmdBufferMemoryBarrier(cmd, {m_bVolumeDesc.buffer,
-                                     VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                     m_traceStages,
                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT});
   vkCmdUpdateBuffer(cmd, m_bVolumeDesc.buffer, 0, sizeof(shaderio::VolumeDesc),
                     &m_volumeDesc);
   nvvk::cmdBufferMemoryBarrier(cmd, {m_bVolumeDesc.buffer,
                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                     VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR});
+                                     m_traceStages});
+
+  // Sequence frames move instance 0, the only one of such scenes
+  if (m_instancesDirty) {
+    nvvk::cmdBufferMemoryBarrier(cmd, {m_bVolumeInstances.buffer,
+                                       m_traceStages,
+                                       VK_PIPELINE_STAGE_2_TRANSFER_BIT});
+    vkCmdUpdateBuffer(cmd, m_bVolumeInstances.buffer, 0, sizeof(shaderio::VolumeInstance),
+                      m_instances.data());
+    nvvk::cmdBufferMemoryBarrier(cmd, {m_bVolumeInstances.buffer,
+                                       VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                       m_traceStages});
+    m_instancesDirty = false;
+  }
+  m_profiler.end(cmd, FrameProfiler::eSceneUpdate);
 }
 
-void Raytracer::raytrace(const VkCommandBuffer &cmd) {
+//---------------------------------------------------------------------------------------------------------------
+// Takes the next converged-pixel counter of the ring. Its previous count was written
+// kConvergenceSlots frames ago and is normally complete; it is used only if it belongs
+// to the current accumulation, so the stop decision lags a few frames but never waits.
+//
+void Raytracer::prepareConvergenceCounter(VkCommandBuffer cmd) {
+  const uint32_t slot = m_convergenceCursor;
+  m_convergenceCursor = (m_convergenceCursor + 1) % kConvergenceSlots;
+
+  if (m_convergenceEpoch[slot] == m_accumEpoch) {
+    NVVK_CHECK(vmaInvalidateAllocation(m_allocator, m_bConvergence.allocation, 0, VK_WHOLE_SIZE));
+    // Tiled frames count their band only; the others keep their last count
+    m_tileConverged[m_convergenceTile[slot]] =
+        static_cast<const uint32_t *>(m_bConvergence.mapping)[slot];
+    const double count = std::accumulate(m_tileConverged.begin(), m_tileConverged.end(), 0.0);
+    const VkExtent2D &size = m_app->getViewportSize();
+    const double pixels = std::max(static_cast<double>(size.width) * size.height, 1.0);
+    m_convergedFraction = static_cast<float>(count / pixels);
+    m_converged = m_settings.noiseThreshold > 0.0f &&
+                  m_convergedFraction >= m_settings.adaptiveStopFraction;
+  }
+
+  nvvk::cmdBufferMemoryBarrier(cmd, {m_bConvergence.buffer,
+                                     m_traceStages,
+                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT});
+  vkCmdFillBuffer(cmd, m_bConvergence.buffer, slot * sizeof(uint32_t), sizeof(uint32_t), 0);
+  nvvk::cmdBufferMemoryBarrier(cmd, {m_bConvergence.buffer,
+                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                     m_traceStages});
+  m_convergenceEpoch[slot] = m_accumEpoch;
+  m_convergenceTile[slot] = m_sceneInfo.tileIndex;
+  m_sceneInfo.convergenceSlot = slot;
+}
+
+void Raytracer::raytrace(const VkCommandBuffer &cmd, bool countConverged) {
   NVVK_DBG_SCOPE(cmd); // <-- Helps to debug in NSight
 
-  // Bind the ray tracing pipeline
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
+  const bool compute = m_backend != RenderBackend::eRayTracing;
+  const bool wavefront = m_backend == RenderBackend::eWavefront;
+  const VkExtent2D &size = m_app->getViewportSize();
+  if (wavefront && (m_wavefrontSize.width != size.width || m_wavefrontSize.height != size.height)) {
+    createWavefrontBuffers(size);
+  }
+  const VkPipelineBindPoint bindPoint =
+      compute ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR;
+
+  // Bind the ray tracing or compute pipeline; the wavefront stages bind their own
+  if (!wavefront) {
+    vkCmdBindPipeline(cmd, bindPoint,
+                      compute ? m_pipelines.compute[static_cast<size_t>(m_backend) -
+                                                   static_cast<size_t>(RenderBackend::eCompute)]
+                              : m_pipelines.rayTracing);
+  }
+  pushRaytraceDescriptors(cmd, bindPoint, wavefront);
+
+  // Ray trace, or one 8x8 workgroup per tile, over the band of this frame; the
+  // wavefront stages run over every pixel and skip those outside the band
+  const glm::uvec2 rows = tileRows(size.height);
+  const uint32_t bandHeight = rows.y - rows.x;
+  m_profiler.begin(cmd, FrameProfiler::eTraceRays);
+  if (wavefront) {
+    traceWavefront(cmd);
+  } else if (compute) {
+    vkCmdDispatch(cmd, (size.width + kComputeTileSize - 1) / kComputeTileSize,
+                  (bandHeight + kComputeTileSize - 1) / kComputeTileSize, 1);
+  } else {
+    const nvvk::SBTGenerator::Regions &regions = m_sbtGenerator.getSBTRegions();
+    vkCmdTraceRaysKHR(cmd, &regions.raygen, &regions.miss, &regions.hit,
+                      &regions.callable, size.width, bandHeight, 1);
+  }
+  m_profiler.end(cmd, FrameProfiler::eTraceRays);
 
-  // Push descriptor sets for ray tracing
+  // Make the converged-pixel count visible to the host read a few frames later
+  if (countConverged) {
+    nvvk::cmdBufferMemoryBarrier(cmd, {m_bConvergence.buffer,
+                                       m_traceStages,
+                                       VK_PIPELINE_STAGE_2_HOST_BIT});
+  }
+}
+
+// Push descriptors are per bind point: the denoiser pushes the same set for compute.
+void Raytracer::pushRaytraceDescriptors(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint,
+                                        bool wavefront) {
   nvvk::WriteSetContainer write{};
   write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eOutImage),
                m_gBuffers.getColorImageView(), VK_IMAGE_LAYOUT_GENERAL);
   write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eSceneDesc),
                m_bSceneInfo.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  const auto *frame = m_sequence.current();
   write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eVolumeGrid),
-               m_bVolumeGrid.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+               frame ? frame->grid.buffer : m_bVolumeGrid.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
   write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eVolumeDesc),
                 m_bVolumeDesc.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
   write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eHdrImage),
                VkDescriptorImageInfo{.sampler     = m_linearSampler,
                                      .imageView   = m_hdrImageView,
                                      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
-  
-  vkCmdPushDescriptorSetKHR(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-                            m_rtPipelineLayout, 0, write.size(), write.data());
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eMajorantGrid),
+               frame ? frame->majorants.buffer : m_bMajorantGrid.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eEnvDistribution),
+               m_bEnvDistribution.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eAccumBuffer),
+               m_bAccum.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eConvergence),
+               m_bConvergence.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eVolumeInstances),
+               m_bVolumeInstances.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eLights),
+               m_bLights.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eReservoirs),
+               m_bReservoirs.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eHistoryBuffer),
+               m_bHistory.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eAovBuffer),
+               m_bAov.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eDenoiseBuffer),
+               m_bDenoise.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eTransmittanceCache),
+               m_bTransmittanceCache.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  if (m_useRayQuery) {
+    write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eTopLevelAS), m_asBuilder.tlas);
+  }
+  if (wavefront) {
+    write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eWavefrontPaths),
+                 m_bWavefrontPaths.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+    write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eWavefrontQueues),
+                 m_bWavefrontQueues.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+    write.append(m_rtDescPack.makeWrite(shaderio::BindingIndex::eWavefrontCounters),
+                 m_bWavefrontCounters.buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  }
+
+  vkCmdPushDescriptorSetKHR(cmd, bindPoint, m_rtPipelineLayout, 0, write.size(), write.data());
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Edge-aware a-trous denoiser (denoiseAtrous in renderer_compute.slang): denoisePasses compute
+// passes over the accumulation and its AOVs, the last of which overwrites the output
+// image. The barriers order it after the trace and before the next frame's.
+//
+void Raytracer::denoise(VkCommandBuffer cmd) {
+  NVVK_DBG_SCOPE(cmd);
+  const VkExtent2D &size = m_app->getViewportSize();
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines.denoise);
+  pushRaytraceDescriptors(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, false);
+
+  shaderio::WavefrontPushConstant push{
+      .filterPassCount = m_settings.denoisePasses,
+      .luminanceSigma = m_settings.denoiseLuminanceSigma,
+      .depthSigma = m_settings.denoiseDepthSigma,
+      .transmittanceSigma = m_settings.denoiseTransmittanceSigma,
+  };
+  for (uint32_t pass = 0; pass < m_settings.denoisePasses; ++pass) {
+    cmdAccumulationBarrier(cmd, m_traceStages);
+    push.filterPass = pass;
+    vkCmdPushConstants(cmd, m_rtPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(push), &push);
+    vkCmdDispatch(cmd, (size.width + kComputeTileSize - 1) / kComputeTileSize,
+                  (size.height + kComputeTileSize - 1) / kComputeTileSize, 1);
+  }
+  cmdAccumulationBarrier(cmd, m_traceStages);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Ray-marched preview (previewMarch in renderer_compute.slang) for the frames in which the
+// camera or the scene keeps changing. The scene is updated as for a traced frame, but
+// nothing is accumulated; onRender restarts the accumulation once the changes settle.
+//
+void Raytracer::renderPreview(VkCommandBuffer cmd) {
+  NVVK_DBG_SCOPE(cmd);
+  // No path samples, so the frame stays out of the cost estimate of scheduleFrame
+  FrameProfiler::FrameInfo frameInfo = profilerFrameInfo(0);
+  frameInfo.backend = "preview";
+  m_profiler.beginFrame(cmd, frameInfo);
+  // The preview leaves the accumulation alone, so with reprojection the path tracer
+  // resumes from it (see updateSceneBuffer), unless more than the camera changed.
+  if (!m_previewShown) {
+    m_previewHistory = m_settings.reproject && historyComplete();
+    m_previewViewProjMatrix = m_sceneInfo.viewProjMatrix;
+    m_previewCameraPosition = m_sceneInfo.cameraPosition;
+  } else if (m_sceneInfo.frameIndex == 0) {
+    m_previewHistory = false;
+  }
+  m_previewShown = true;
+  updateSceneBuffer(cmd, false);
+  buildTransmittanceCache(cmd, false);
 
-  // Ray trace
-  const nvvk::SBTGenerator::Regions &regions = m_sbtGenerator.getSBTRegions();
   const VkExtent2D &size = m_app->getViewportSize();
-  vkCmdTraceRaysKHR(cmd, &regions.raygen, &regions.miss, &regions.hit,
-                    &regions.callable, size.width, size.height, 1);
-}
\ No newline at end of file
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines.preview);
+  pushRaytraceDescriptors(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, false);
+  m_profiler.begin(cmd, FrameProfiler::eTraceRays);
+  vkCmdDispatch(cmd, (size.width + kComputeTileSize - 1) / kComputeTileSize,
+                (size.height + kComputeTileSize - 1) / kComputeTileSize, 1);
+  m_profiler.end(cmd, FrameProfiler::eTraceRays);
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Transmittance cache build (buildTransmittanceCache in renderer_compute.slang). Interactive
+// frames build one slab of cells each, so a rebuild is spread over
+// kTransmittanceCacheBuildFrames frames next to the tracing; offline renders build
+// every slab at once. The accumulation restarts when the cache comes into use.
+//
+void Raytracer::buildTransmittanceCache(VkCommandBuffer cmd, bool allSlabs) {
+  if (!transmittanceCachePending()) {
+    return;
+  }
+  NVVK_DBG_SCOPE(cmd);
+  const uint32_t res = m_sceneInfo.transmittanceCacheRes;
+  const uint32_t cellCount = res * res * res;
+  const uint32_t slab = allSlabs ? cellCount
+                                 : (cellCount + kTransmittanceCacheBuildFrames - 1) /
+                                       kTransmittanceCacheBuildFrames;
+
+  shaderio::WavefrontPushConstant push{
+      .cacheCellBegin = m_transmittanceCacheCursor,
+      .cacheCellEnd = std::min(m_transmittanceCacheCursor + slab, cellCount),
+  };
+  cmdAccumulationBarrier(cmd, m_traceStages);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines.transmittanceCache);
+  pushRaytraceDescriptors(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, false);
+  vkCmdPushConstants(cmd, m_rtPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(push), &push);
+  vkCmdDispatch(cmd, (push.cacheCellEnd - push.cacheCellBegin + 63) / 64, 1, 1);
+  cmdAccumulationBarrier(cmd, m_traceStages);
+
+  m_transmittanceCacheCursor = push.cacheCellEnd;
+  if (m_transmittanceCacheCursor == cellCount) {
+    m_transmittanceCacheReady = true;
+    m_sceneInfo.frameIndex = 0;
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+// Records the wavefront integrator: sampleCount waves of one path per pixel, each
+// running the stages depth by depth over the queues, then one resolve pass. Queue
+// sizes stay on the device; every queue-driven stage is an indirect dispatch.
+//
+void Raytracer::traceWavefront(VkCommandBuffer cmd) {
+  const VkExtent2D &size = m_app->getViewportSize();
+  const uint32_t pathGroups =
+      (size.width * size.height + shaderio::kWavefrontGroupSize - 1) / shaderio::kWavefrontGroupSize;
+  const auto queueBit = [](shaderio::WavefrontQueue queue) { return 1u << queue; };
+
+  shaderio::WavefrontPushConstant push{};
+  const auto bindStage = [&](WavefrontStage stage) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines.wavefront[stage]);
+    vkCmdPushConstants(cmd, m_rtPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(push), &push);
+  };
+  const auto dispatch = [&](WavefrontStage stage, uint32_t groups) {
+    bindStage(stage);
+    vkCmdDispatch(cmd, groups, 1, 1);
+    cmdWavefrontBarrier(cmd);
+  };
+  // One thread per entry of `queue`, sized by the last wfPrepare
+  const auto dispatchQueue = [&](WavefrontStage stage, shaderio::WavefrontQueue queue) {
+    push.inQueue = queue;
+    bindStage(stage);
+    vkCmdDispatchIndirect(cmd, m_bWavefrontCounters.buffer, (queue * 4 + 1) * sizeof(uint32_t));
+    cmdWavefrontBarrier(cmd);
+  };
+  const auto prepare = [&](uint32_t resetMask) {
+    push.resetMask = resetMask;
+    dispatch(eWfPrepare, 1);
+    push.resetMask = 0;
+  };
+
+  const int maxDepth = std::max(m_sceneInfo.maxScatterDepth, 1);
+  for (uint32_t wave = 0; wave < m_sceneInfo.sampleCount; ++wave) {
+    push = {.sampleIndex = wave};
+    prepare((1u << shaderio::eQueueCount) - 1);
+    dispatch(eWfGenerate, pathGroups);
+
+    for (int depth = 0; depth < maxDepth; ++depth) {
+      const auto current = static_cast<shaderio::WavefrontQueue>(shaderio::eQueueRay0 + (depth & 1));
+      const auto next = static_cast<shaderio::WavefrontQueue>(shaderio::eQueueRay0 + ((depth + 1) & 1));
+      push.depth = static_cast<uint32_t>(depth);
+
+      prepare(queueBit(next) | queueBit(shaderio::eQueueScatter) | queueBit(shaderio::eQueueSorted));
+      dispatchQueue(eWfDistance, current);
+      prepare(0);
+
+      // Counting sort of the scattered paths by leaf, so neighbouring threads of the
+      // NEE and shading stages (and of the next depth) touch the same bricks.
+      shaderio::WavefrontQueue shadeQueue = shaderio::eQueueScatter;
+      if (m_settings.wavefrontSort) {
+        dispatchQueue(eWfSortHistogram, shaderio::eQueueScatter);
+        push.outQueue = shaderio::eQueueSorted;
+        dispatch(eWfSortScan, 1);
+        dispatchQueue(eWfSortScatter, shaderio::eQueueScatter);
+        prepare(0);
+        shadeQueue = shaderio::eQueueSorted;
+      }
+
+      dispatchQueue(eWfShadow, shadeQueue);
+      push.outQueue = next;
+      dispatchQueue(eWfShade, shadeQueue);
+    }
+
+    prepare(0);
+    dispatchQueue(eWfMiss, shaderio::eQueueMiss);
+  }
+
+  dispatch(eWfResolve, pathGroups);
+}
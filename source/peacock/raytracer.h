@@ -1,9 +1,16 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <string>
 
+#include <future>
+#include <map>
 #include <memory>
-#include <nanovdb/GridHandle.h>
+#include <mutex>
+#include <optional>
+#include <vector>
 #include <nvapp/application.hpp>
 #include <nvslang/slang.hpp>
 #include <nvutils/camera_manipulator.hpp>
@@ -16,13 +23,44 @@
 #include <nvvk/sbt_generator.hpp>
 #include <nvvk/staging.hpp>
 
+#include "peacock/frame_profiler.h"
+#include "peacock/pipeline_cache.h"
+#include "peacock/render_settings.h"
+#include "peacock/scene/environment.h"
+#include "peacock/scene/host_volume.h"
+#include "peacock/scene/light_list.h"
+#include "peacock/scene/majorant_grid.h"
+#include "peacock/scene/volume_scene.h"
+#include "peacock/shader_reloader.h"
 #include "peacock/shaderio.h"
+#include "peacock/volume_sequence_player.h"
 
 namespace peacock {
 
+// How the integrator is dispatched. Volume traversal uses ray queries at most, so the
+// compute variants need no ray tracing pipeline and can be compared against the SBT path.
+enum class RenderBackend { eRayTracing, eCompute, eComputeMorton, eWavefront, eCount };
+
+// "auto" resolves to eRayTracing when supported, eCompute otherwise.
+RenderBackend parseRenderBackend(const std::string &name, bool rayTracingSupported);
+const char *renderBackendName(RenderBackend backend);
+
+// Uniform numbers of the path decisions: independent, sobol or rank1 (see shaderio.h).
+shaderio::SampleSequence parseSampleSequence(const std::string &name);
+const char *sampleSequenceName(shaderio::SampleSequence sequence);
+
+// Shadow-ray transmittance estimator: residual, ratio or track-length (see shaderio.h).
+shaderio::TransmittanceEstimator parseTransmittanceEstimator(const std::string &name);
+const char *transmittanceEstimatorName(shaderio::TransmittanceEstimator estimator);
+
+// Reservoir reuse of resampled direct lighting: none, temporal, spatial or both
+// (kRestir* flags, see shaderio.h).
+uint32_t parseRestirReuse(const std::string &name);
+const char *restirReuseName(uint32_t reuse);
+
 class Raytracer : public nvapp::IAppElement {
 public:
-  Raytracer() = default;
+  explicit Raytracer(const RaytracerSettings &settings = {}) : m_settings(settings) {}
 
   ~Raytracer() = default;
 
@@ -32,26 +70,152 @@ public:
   void onUIRender() override;
   void onUIMenu() override;
   void onRender(VkCommandBuffer cmd) override;
+  void onLastHeadlessFrame() override;
 
   std::shared_ptr<nvutils::CameraManipulator> getCameraManipulator() const { return m_cameraManip; }
 
+  // The optional ray tracing extensions the logical device was created with (see
+  // main.cpp). Must be set before the element is attached; both default to off.
+  void setRayTracingEnabled(bool rayTracingPipeline, bool rayQuery) {
+    m_rayTracingSupported = rayTracingPipeline;
+    m_rayQuerySupported = rayQuery;
+  }
+
 private:
+  // Stages of the wavefront backend, one compute pipeline each.
+  enum WavefrontStage {
+    eWfPrepare,
+    eWfGenerate,
+    eWfDistance,
+    eWfSortHistogram,
+    eWfSortScan,
+    eWfSortScatter,
+    eWfShadow,
+    eWfShade,
+    eWfMiss,
+    eWfResolve,
+    eWfStageCount
+  };
+
+  // Every pipeline built from one renderer module. The compute pipelines are indexed
+  // by RenderBackend - eCompute and always created, so the backend can be switched live.
+  struct PipelineSet {
+    VkPipeline rayTracing{VK_NULL_HANDLE};
+    std::array<VkPipeline, 2> compute{};
+    std::array<VkPipeline, eWfStageCount> wavefront{};
+    VkPipeline denoise{VK_NULL_HANDLE};
+    VkPipeline preview{VK_NULL_HANDLE};
+    VkPipeline transmittanceCache{VK_NULL_HANDLE};
+  };
+
+  // Scene-constant choices baked into the renderer as specialization constants (see
+  // renderer.slang). The default key is the generic variant, which reads them from the
+  // scene buffers and runs any scene.
+  struct PipelineVariant {
+    int32_t maxScatterDepth{0};        // 0 = SceneInfo::maxScatterDepth
+    int32_t russianRouletteDepth{-1};  // < 0 = SceneInfo::russianRouletteDepth
+    bool isotropic{false};             // g == 0 for every instance
+    bool nonAbsorbing{false};          // sigma_a == 0 for every instance
+
+    auto operator<=>(const PipelineVariant &) const = default;
+    std::string label() const;
+  };
 
-  void loadVolume(const std::filesystem::path &vdbPath);
+  // SPIR-V of the renderer: renderer.slang holds the ray generation shader and is only
+  // loaded when the ray tracing pipeline is enabled; every compute pipeline comes from
+  // renderer_compute.slang, which devices without it accept.
+  struct RendererSpirv {
+    std::vector<uint32_t> rayTracing;
+    std::vector<uint32_t> compute;
+  };
+
+  // A compiled generic set published by the hot-reload worker, with its SPIR-V so the
+  // specialized variants can be rebuilt from the same code.
+  struct PendingShaders {
+    RendererSpirv spirv;
+    PipelineSet pipelines;
+  };
+
+  void loadScene(const VolumeScene &scene);
+  void createAccelerationStructures();
   void loadHdrIbl(const std::filesystem::path &hdrPath);
+  void loadLights();
+  void applyVolumeFrame(const VolumeSequencePlayer::Slot &slot);
 
   void createResources();
+  void createAccumBuffer(const VkExtent2D &size);
+  void cmdCopyHistory(VkCommandBuffer cmd);
+  void createReservoirBuffer(VkCommandBuffer cmd, const VkExtent2D &size);
+  void clearReservoirs(VkCommandBuffer cmd);
+  void createDenoiseBuffers(const VkExtent2D &size);
+  void createTransmittanceCache();
 
-  VkShaderModuleCreateInfo compileSlangShader(const std::filesystem::path& filename, const std::span<const uint32_t>& spirv);
+  RendererSpirv rendererSpirv() const;
   void createRaytraceDescriptorLayout();
-  void createRayTracingPipeline();
+  void createPipelineLayout();
+  PipelineSet createPipelines(const RendererSpirv &spirv,
+                              const PipelineVariant &variant) const;
+  void destroyPipelines(PipelineSet &pipelines) const;
+  void retireVariants();
+
+  // Pipeline variants
+  PipelineVariant sceneVariant() const;
+  void selectPipelineVariant();
+  void bindPipelineVariant(const PipelineVariant &variant);
+  void variantsUI();
+  void createWavefrontBuffers(const VkExtent2D &size);
   void createShaderBindingTable(const VkRayTracingPipelineCreateInfoKHR& rtPipelineInfo);
 
-  void updateSceneBuffer(VkCommandBuffer cmd);
+  // Shader hot reload
+  std::filesystem::path findShaderDirectory() const;
+  bool rebuildShaders();
+  void installPendingPipelines();
+  void shadersUI();
+
+  // The next updateSceneBuffer restarts the accumulation: the camera moved or a change reset it.
+  bool restartPending() const { return m_sceneInfo.frameIndex == 0 || cameraMoved(); }
+  bool cameraMoved() const { return glm::inverse(m_cameraManip->getViewMatrix()) != m_prevViewMatrix; }
+  // A UI edit: restarts the accumulation and, unlike internal restarts, holds the preview.
+  void restartAfterEdit() {
+    m_sceneInfo.frameIndex = 0;
+    m_lastChange = std::chrono::steady_clock::now();
+  }
+  // Every band has been traced since the last restart, so the accumulation shows a single view.
+  bool historyComplete() const { return m_sceneInfo.frameIndex >= m_sceneInfo.tileCount; }
+  void scheduleFrame();
+  void updateSceneBuffer(VkCommandBuffer cmd, bool countConverged);
+  // Rows [x, y) of the band traced this frame, all of them unless tiled.
+  glm::uvec2 tileRows(uint32_t height) const {
+    return {height * m_sceneInfo.tileIndex / m_sceneInfo.tileCount,
+            height * (m_sceneInfo.tileIndex + 1) / m_sceneInfo.tileCount};
+  }
+  void prepareConvergenceCounter(VkCommandBuffer cmd);
 
-  void raytrace(const VkCommandBuffer &cmd);
+  void pushRaytraceDescriptors(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, bool wavefront);
+  void raytrace(const VkCommandBuffer &cmd, bool countConverged);
+  bool denoising() const { return m_settings.denoise && m_settings.denoisePasses > 0; }
+  void denoise(VkCommandBuffer cmd);
+  void traceWavefront(VkCommandBuffer cmd);
+  void renderPreview(VkCommandBuffer cmd);
+  bool transmittanceCachePending() const {
+    return m_settings.transmittanceCacheDepth > 0 && !m_transmittanceCacheReady;
+  }
+  void invalidateTransmittanceCache() {
+    m_transmittanceCacheReady = false;
+    m_transmittanceCacheCursor = 0;
+  }
+  void buildTransmittanceCache(VkCommandBuffer cmd, bool allSlabs);
+
+  void renderOfflineBatch(VkCommandBuffer cmd);
+  FrameProfiler::FrameInfo profilerFrameInfo(uint32_t dispatches) const;
+  void statisticsUI();
+  std::vector<float> readbackImage(const nvvk::Buffer &source, VkDeviceSize firstPixel,
+                                   uint32_t vec4PerPixel);
+  void saveImage(const std::filesystem::path &path, const std::vector<float> &rgb);
 
 private:
+  RaytracerSettings m_settings;
+
   // Application and core components
   nvapp::Application *m_app{};
   nvvk::ResourceAllocator m_allocator{};
@@ -65,12 +229,57 @@ private:
 
   shaderio::SceneInfo m_sceneInfo;
   shaderio::VolumeDesc m_volumeDesc;
-  nanovdb::GridHandle<> m_gridHandle;
+  VolumeScene m_scene;
+  std::vector<HostVolume> m_hostVolumes;  // one per distinct volume of m_scene
+  std::vector<shaderio::VolumeInstance> m_instances;
+  bool m_instancesDirty{false};  // instance 0 changed (sequence frames), re-upload it
   bool m_volumeUploaded{false};
-  float m_maxDensity{1.0f};  // raw grid maximum, used to compute sigmaMax
+  float m_maxDensity{1.0f};  // largest raw grid maximum x instance density, used to compute sigmaMax
   float m_hgG{0.0f};         // Henyey-Greenstein anisotropy g
   glm::mat4 m_prevViewMatrix{0.0f};  // for camera-change detection
 
+  // fp32 accumulation: per pixel the running mean and luminance moments (2 x vec4)
+  nvvk::Buffer m_bAccum;
+  nvvk::Buffer m_bHistory;  // m_bAccum before the last camera move, for reprojection
+
+  // Converged-pixel counters, one slot per frame in a ring deeper than the frames in
+  // flight; a slot is read back on the host right before it is reused.
+  static constexpr uint32_t kConvergenceSlots = 4;
+  nvvk::Buffer m_bConvergence;
+  std::array<uint32_t, kConvergenceSlots> m_convergenceEpoch{};  // 0 = never counted
+  std::array<uint32_t, kConvergenceSlots> m_convergenceTile{};   // band the slot counted
+  std::vector<uint32_t> m_tileConverged;  // latest count of every band this epoch
+  uint32_t m_convergenceCursor{0};
+  uint32_t m_accumEpoch{0};  // bumped whenever accumulation restarts
+  float m_convergedFraction{0.0f};
+  bool m_converged{false};   // adaptiveStopFraction reached, no more dispatches
+
+  // GPU timestamps of scene update and trace, rolling stats and CSV stream
+  FrameProfiler m_profiler;
+
+  // Time-budgeted sampling, see scheduleFrame
+  static constexpr uint32_t kMaxFrameSpp = 64;
+  static constexpr uint32_t kMaxFrameTiles = 16;
+  double m_pathCostMs{0.0};           // smoothed GPU trace time of one path
+  uint64_t m_costStatsFrame{~0ull};   // profiler frame last folded into m_pathCostMs
+  uint32_t m_scheduledTiles{1};       // bands of the next restarted accumulation
+  uint32_t m_tileCursor{0};           // band of the next frame modulo tileCount, never reset
+  std::chrono::steady_clock::time_point m_lastRestart{};
+
+  // Ray-marched preview: shown until kPreviewHold has passed since the last change
+  static constexpr std::chrono::milliseconds kPreviewHold{200};
+  std::chrono::steady_clock::time_point m_lastChange{};
+  bool m_previewShown{false};  // the frames since the last change were previews
+  // The accumulation from before the preview, to reproject on handover: only camera
+  // changes happened since, and the view it was traced from
+  bool m_previewHistory{false};
+  glm::mat4 m_previewViewProjMatrix{1.0f};
+  glm::vec3 m_previewCameraPosition{0.0f};
+
+  // Offline rendering progress
+  uint32_t m_offlineDispatches{0};
+  std::chrono::steady_clock::time_point m_offlineStart{};
+
   // camera info
   nvvk::Buffer m_bSceneInfo;
 
@@ -80,18 +289,88 @@ private:
   // volume grid data (NanoVDB)
   nvvk::Buffer m_bVolumeGrid;
 
+  // per-cell density bounds for the DDA majorant iterator, all volumes packed
+  nvvk::Buffer m_bMajorantGrid;
+
+  // placed volumes (shaderio::VolumeInstance)
+  nvvk::Buffer m_bVolumeInstances;
+
+  // animated sequences: owns the grid/majorant buffers of every frame after the first
+  VolumeSequencePlayer m_sequence;
+
   // hdr
+  EnvironmentMap m_environment;
+  nvvk::Buffer  m_bEnvDistribution;  // importance-sampling tables, see EnvironmentMap
   nvvk::Image   m_hdrImage;
   VkImageView   m_hdrImageView{VK_NULL_HANDLE};
   VkSampler     m_linearSampler{VK_NULL_HANDLE};
 
+  // NEE light list: the environment plus the scene lights, with their alias table
+  LightList    m_lights;
+  nvvk::Buffer m_bLights;
+  nvvk::Buffer m_bReservoirs;  // resampled direct lighting, ping-pong by frame index
+
+  // Denoiser: AOVs accumulated with the image (2 x vec4 per pixel) and the a-trous
+  // ping-pong (2 x vec4 per pixel); m_denoiseDirty reruns the filter on a stopped image.
+  nvvk::Buffer m_bAov;
+  nvvk::Buffer m_bDenoise;
+  bool m_denoiseDirty{false};
+
+  // Shadow transmittance grid (3 x vec4 per cell), built a slab per frame after an
+  // invalidation and only read once complete
+  static constexpr uint32_t kTransmittanceCacheBuildFrames = 8;
+  nvvk::Buffer m_bTransmittanceCache;
+  uint32_t m_transmittanceCacheCursor{0};  // first cell of the next slab
+  bool m_transmittanceCacheReady{false};
+
   // Ray Tracing Pipeline Components
   nvvk::DescriptorPack m_rtDescPack;
-  VkPipeline m_rtPipeline{};
-  VkPipelineLayout m_rtPipelineLayout{};
+  VkPipelineLayout m_rtPipelineLayout{};  // shared with the compute pipelines
+
+  RenderBackend m_backend{RenderBackend::eRayTracing};
+  bool m_rayTracingSupported{false};
+  PipelineSet m_pipelines;  // bound set, owned by m_variants
+  PipelineCache m_pipelineCache;  // persisted between runs, see PipelineCache
+
+  // Pipeline variants built so far from m_spirv; the generic one always exists. A
+  // missing variant is built in the background while the generic one keeps rendering.
+  RendererSpirv m_spirv;
+  std::map<PipelineVariant, PipelineSet> m_variants;
+  PipelineVariant m_boundVariant;
+  std::future<PipelineSet> m_variantBuild;
+  PipelineVariant m_variantBuildKey;
+  uint32_t m_shaderGeneration{0};  // bumped with m_spirv, stale builds are dropped
+  uint32_t m_variantBuildGeneration{0};
+
+  // Profiler ids: 2 * (index of the scene variant) + 1 when it ran specialized, so
+  // each scene's generic and specialized throughput can be compared.
+  std::map<PipelineVariant, uint32_t> m_variantIds;
+  uint32_t m_statsVariant{0};
+
+  // Hot reload: the worker of m_shaderReloader builds a generic set into
+  // m_pendingShaders; onRender swaps it in and retires every variant built from the
+  // old code once the frames in flight are done with them.
+  ShaderReloader m_shaderReloader;
+  std::mutex m_pendingMutex;
+  std::optional<PendingShaders> m_pendingShaders;
+
+  // Wavefront backend: SoA path state and queues sized for one path per pixel,
+  // created the first time the backend is used.
+  nvvk::Buffer m_bWavefrontPaths;
+  nvvk::Buffer m_bWavefrontQueues;
+  nvvk::Buffer m_bWavefrontCounters;  // also the indirect dispatch arguments
+  VkExtent2D m_wavefrontSize{};
+
+  // Stages that run the integrator; barriers must not name the ray tracing stage
+  // on devices without the ray tracing pipeline.
+  VkPipelineStageFlags2 m_traceStages{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT};
 
-  // Acceleration Structure Components
+  // Acceleration Structure Components: one AABB BLAS per distinct volume and a TLAS
+  // with one instance per volume instance, traversed with ray queries. Only built for
+  // scenes with several instances; a single one is cheaper to test directly.
   nvvk::AccelerationStructureHelper m_asBuilder{};
+  bool m_rayQuerySupported{false};
+  bool m_useRayQuery{false};
   nvvk::SBTGenerator m_sbtGenerator;
   nvvk::Buffer m_sbtBuffer;
 
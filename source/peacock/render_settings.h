@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include <glm/glm.hpp>
+
+namespace peacock {
+
+// Start-up options, normally filled from the command line in main.cpp.
+struct RaytracerSettings {
+  std::filesystem::path volumePath{"/home/jyxiong/Projects/peacock/asset/bunny_cloud.vdb"};
+  // Multi-volume scene file (see scene/volume_scene.h); replaces volumePath when set.
+  std::filesystem::path scenePath;
+  std::filesystem::path hdrPath{"/home/jyxiong/Projects/peacock/asset/belfast_sunset_puresky_2k.hdr"};
+  // Directional sun added to the scene lights (irradiance, 0 = none); scene files can
+  // declare more lights, see scene/volume_scene.h.
+  glm::vec3 sunDirection{0.3f, 1.0f, 0.2f};  // towards the sun
+  glm::vec3 sunRadiance{0.0f};
+  // Resampled direct lighting: light candidates per scatter event, of which only one
+  // gets a shadow ray (0 = plain NEE with MIS), and reservoir reuse across frames and
+  // neighbouring pixels: none, temporal, spatial or both.
+  uint32_t lightCandidates{8};
+  std::string lightReuse{"none"};
+
+  // Explicit camera; when eye == center the camera is framed on the volume bounds.
+  glm::vec3 eye{0.0f};
+  glm::vec3 center{0.0f};
+  glm::vec3 up{0.0f, 1.0f, 0.0f};
+  float fov{60.0f};
+
+  // Offline rendering: no window, back-to-back dispatches, result written to outputPath.
+  bool headless{false};
+  std::filesystem::path outputPath{"peacock.exr"};  // .exr or .pfm
+  uint32_t targetSpp{256};
+  uint32_t sppPerDispatch{1};
+  uint32_t dispatchesPerFrame{16};  // dispatches recorded into one submitted command buffer
+
+  // GPU dispatch: raytracing (single-raygen pipeline + SBT), compute (8x8 tiles),
+  // compute-morton (Z-ordered 8x8 tiles), wavefront (staged kernels over ray queues)
+  // or auto (raytracing when the device supports it).
+  std::string backend{"auto"};
+  bool wavefrontSort{true};  // order scattered paths by NanoVDB leaf between stages
+
+  // Uniform numbers of the path decisions: sobol (Owen-scrambled), rank1 (blue-noise
+  // rotated lattice) or independent (PCG, as the CPU reference backend).
+  std::string sampler{"sobol"};
+
+  // Shadow-ray transmittance: residual (ratio tracking around the per-cell mean
+  // density), ratio (plain ratio tracking) or track-length (delta tracking, 0 or 1).
+  std::string transmittance{"residual"};
+
+  // CPU reference backend: renders the same integrator on all cores, no Vulkan device needed.
+  bool cpu{false};
+  uint32_t cpuThreads{0};  // 0 = all hardware threads
+  uint32_t cpuTileSize{16};
+
+  // Reuse / write the `<volume>.nvdb` sidecar next to the OpenVDB file.
+  bool volumeCache{true};
+
+  // NanoVDB build type of the density grid: float, fp16, fp8, fp4 or fpn.
+  // fpn picks a per-leaf bit width that keeps the error below volumeTolerance.
+  std::string volumePrecision{"float"};
+  float volumeTolerance{0.001f};
+
+  // Play --volume as the first frame of a numbered sequence (smoke.0001.vdb, ...).
+  bool sequence{false};
+  float sequenceFps{24.0f};
+  uint32_t sequenceThreads{2};  // background loader threads
+
+  // Adaptive sampling: pixels stop sampling once the relative standard error of their
+  // luminance drops below noiseThreshold (0 = uniform sampling); rendering stops once
+  // adaptiveStopFraction of the pixels have converged.
+  float noiseThreshold{0.0f};
+  uint32_t adaptiveMinSpp{16};
+  float adaptiveStopFraction{0.999f};
+
+  // Interactive camera motion: reproject the accumulated image into the new view
+  // instead of restarting from 1 spp (see reprojectHistory in renderer.slang).
+  bool reproject{true};
+
+  // Interactive sample scheduling: the samples per pixel of each frame follow the
+  // measured GPU cost of a path so that the trace takes about frameBudgetMs (0 = the
+  // fixed UI value), or idleFrameBudgetMs once the image has accumulated undisturbed
+  // for a second (0 = unlimited, up to 64 spp). When a single sample per pixel
+  // overruns the budget and tiledFrames is on, a frame traces one band of the image.
+  float frameBudgetMs{16.0f};
+  float idleFrameBudgetMs{100.0f};
+  bool tiledFrames{true};
+
+  // Interactive: while the camera or the scene keeps changing, show a biased ray-marched
+  // preview (single scattering of the dominant light, VolumeDesc::stepSize voxels per
+  // step) and restart the path tracer once the changes settle. With reproject, camera
+  // motion under the preview is one reprojection on handover: the restarted path
+  // tracer merges the image accumulated before the preview, as long as only the
+  // camera changed meanwhile. Without the preview, every moving frame reprojects.
+  bool preview{true};
+
+  // Edge-aware a-trous denoiser between the trace and the display, and of the offline
+  // output (the raw image is kept next to it as <name>.noisy.<ext>). denoisePasses
+  // levels of 5x5 taps, guided by volume AOVs that cost one extra ray per pixel and
+  // frame; the sigmas scale the luminance, relative depth and transmittance stops.
+  bool denoise{false};
+  uint32_t denoisePasses{5};
+  float denoiseLuminanceSigma{4.0f};
+  float denoiseDepthSigma{0.2f};
+  float denoiseTransmittanceSigma{0.1f};
+
+  // Per-frame GPU timings and throughput as CSV rows; empty = off (toggle in the UI).
+  std::filesystem::path statsCsvPath;
+
+  // Edge of a majorant-grid cell in voxels; smaller cells give tighter bounds
+  // at the cost of more DDA steps.
+  uint32_t majorantCellSize{16};
+
+  // Density pyramid: lodLevels box-filtered copies of each grid at 2x/4x/8x voxels
+  // (at most 3, 0 = none). Paths sample one level coarser per bounce from scatter
+  // depth lodDepth on, shadow rays from lodShadowDepth on; 0 keeps full resolution.
+  // The coarse levels are biased, so both are off unless asked for; the levels are
+  // still built so the UI can turn them on. Sequence frames always render at full
+  // resolution.
+  uint32_t lodLevels{3};
+  uint32_t lodDepth{0};
+  uint32_t lodShadowDepth{0};
+  // Transmittance cache: shadow rays from scatter depth transmittanceCacheDepth on
+  // (0 = off) look up a transmittanceCacheRes^3 grid over the scene instead of being
+  // tracked; each cell stores the transmittance towards every direction as L1
+  // spherical harmonics. Biased, meant for deep bounces; it is rebuilt over a few
+  // frames whenever the volume or the medium extinction changes.
+  uint32_t transmittanceCacheDepth{0};
+  uint32_t transmittanceCacheRes{32};
+  // Offline: image the result is compared against (e.g. a render without --lod-depth),
+  // to report the bias of the coarse levels; empty = no comparison.
+  std::filesystem::path referencePath;
+
+  // VkPipelineCache persisted between runs; an empty path keeps it next to the executable.
+  bool pipelineCache{true};
+  std::filesystem::path pipelineCachePath;
+
+  // Bake scene constants (depth limits, isotropic phase, no absorption) into specialized
+  // pipeline variants; off always runs the generic kernels.
+  bool specializePipelines{true};
+
+  // Recompile the Slang sources when they change and swap the pipelines in (windowed only).
+  bool hotReload{true};
+
+  bool hasCamera() const { return eye != center; }
+  uint32_t dispatchCount() const { return (targetSpp + sppPerDispatch - 1) / sppPerDispatch; }
+  uint32_t headlessFrameCount() const {
+    return (dispatchCount() + dispatchesPerFrame - 1) / dispatchesPerFrame;
+  }
+};
+
+}  // namespace peacock
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include <nvutils/camera_manipulator.hpp>
+
+namespace peacock {
+
+// Places the camera on +Z so that the box fills the view with a small margin.
+inline void setupCameraForBox(const std::shared_ptr<nvutils::CameraManipulator>& camera,
+                              const glm::vec3& boxMin,
+                              const glm::vec3& boxMax,
+                              float aspect) {
+  const glm::vec3 center = (boxMin + boxMax) * 0.5f;
+  const glm::vec3 halfExtent = (boxMax - boxMin) * 0.5f;
+
+  const float safeAspect = std::max(aspect, 0.1f);
+  const float tanHalfFovY = std::tan(0.5f * glm::radians(camera->getFov()));
+  const float tanHalfFovX = tanHalfFovY * safeAspect;
+
+  const float distX = halfExtent.x / std::max(tanHalfFovX, 1e-4f);
+  const float distY = halfExtent.y / std::max(tanHalfFovY, 1e-4f);
+  const float margin = 1.15f;
+  const float distance = std::max(distX, distY) * margin + halfExtent.z;
+
+  const glm::vec3 eye = center + glm::vec3(0.0f, 0.0f, distance);
+  camera->setLookat(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+}  // namespace peacock
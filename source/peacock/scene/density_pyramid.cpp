@@ -0,0 +1,151 @@
+#include "peacock/scene/density_pyramid.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <nanovdb/tools/CreateNanoGrid.h>
+#include <nanovdb/tools/GridBuilder.h>
+
+namespace peacock {
+
+namespace {
+
+using CoarseGrid = nanovdb::tools::build::Grid<float>;
+
+// Source voxel i sits at coarse index (i - 0.5) / 2: the coarse map doubles the
+// source matrix and moves the origin half a source voxel along every index axis.
+nanovdb::Map halveResolution(const nanovdb::Map& map) {
+  double mat[3][3], invMat[3][3];
+  nanovdb::Vec3d translate;
+  for (int i = 0; i < 3; ++i) {
+    translate[i] = map.mVecD[i];
+    for (int j = 0; j < 3; ++j) {
+      mat[i][j] = 2.0 * map.mMatD[3 * i + j];
+      invMat[i][j] = 0.5 * map.mInvMatD[3 * i + j];
+      translate[i] += 0.5 * map.mMatD[3 * i + j];
+    }
+  }
+  nanovdb::Map coarse;
+  coarse.set(mat, invMat, translate);
+  return coarse;
+}
+
+// Adds the share of a block of source voxels [lo, hi] (inclusive) with constant
+// `value` to every coarse voxel it overlaps; 8 source voxels make one coarse voxel.
+// Blocks are clipped to the source bounds plus the trilinear footprint, so large
+// background tiles do not blow up the coarse tree.
+template <typename AccessorT>
+void accumulate(AccessorT& acc, const nanovdb::CoordBBox& clip, nanovdb::Coord lo,
+                nanovdb::Coord hi, float value) {
+  if (value == 0.0f) {
+    return;
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    lo[axis] = std::max(lo[axis], clip.min()[axis]);
+    hi[axis] = std::min(hi[axis], clip.max()[axis]);
+    if (lo[axis] > hi[axis]) {
+      return;
+    }
+  }
+  // Arithmetic shifts floor negative coordinates too
+  const nanovdb::Coord cLo(lo[0] >> 1, lo[1] >> 1, lo[2] >> 1);
+  const nanovdb::Coord cHi(hi[0] >> 1, hi[1] >> 1, hi[2] >> 1);
+  auto overlap = [&](int axis, int c) {
+    return std::min(hi[axis], 2 * c + 1) - std::max(lo[axis], 2 * c) + 1;
+  };
+  for (int z = cLo[2]; z <= cHi[2]; ++z) {
+    for (int y = cLo[1]; y <= cHi[1]; ++y) {
+      for (int x = cLo[0]; x <= cHi[0]; ++x) {
+        const nanovdb::Coord c(x, y, z);
+        const int voxels = overlap(0, x) * overlap(1, y) * overlap(2, z);
+        acc.setValue(c, acc.getValue(c) + value * static_cast<float>(voxels) * 0.125f);
+      }
+    }
+  }
+}
+
+template <typename AccessorT, typename NodeT>
+void accumulateTiles(AccessorT& acc, const nanovdb::CoordBBox& clip, const NodeT& node) {
+  using ChildT = typename NodeT::ChildNodeType;
+  const auto* data = node.data();
+  for (uint32_t n = 0; n < NodeT::SIZE; ++n) {
+    if (!data->mChildMask.isOn(n)) {
+      const nanovdb::Coord tileMin = node.offsetToGlobalCoord(n);
+      accumulate(acc, clip, tileMin, tileMin.offsetBy(ChildT::DIM - 1),
+                 static_cast<float>(data->mTable[n].value));
+    }
+  }
+}
+
+// One 2x box-filter step. Walks the tree like MajorantGrid::build: leaves through
+// their parents (FpN leaves vary in size), then the tiles of every level.
+template <typename BuildT>
+nanovdb::GridHandle<> downsample(const nanovdb::NanoGrid<BuildT>& grid) {
+  CoarseGrid coarse(0.0f, grid.gridName(), grid.gridClass());
+  coarse.mMap = halveResolution(grid.map());
+  auto acc = coarse.getAccessor();
+  const nanovdb::CoordBBox clip = grid.indexBBox().expandBy(1);
+
+  const auto& tree = grid.tree();
+  const auto* lowers = tree.getFirstLower();
+  for (uint32_t i = 0; i < tree.nodeCount(1); ++i) {
+    const auto& lower = lowers[i];
+    for (uint32_t n = 0; n < lower.SIZE; ++n) {
+      if (!lower.data()->mChildMask.isOn(n)) {
+        continue;
+      }
+      const auto& leaf = *lower.getChild(n);
+      for (uint32_t v = 0; v < leaf.SIZE; ++v) {
+        const nanovdb::Coord voxel = leaf.offsetToGlobalCoord(v);
+        accumulate(acc, clip, voxel, voxel, static_cast<float>(leaf.getValue(v)));
+      }
+    }
+    accumulateTiles(acc, clip, lower);
+  }
+  const auto* uppers = tree.getFirstUpper();
+  for (uint32_t i = 0; i < tree.nodeCount(2); ++i) {
+    accumulateTiles(acc, clip, uppers[i]);
+  }
+  const auto* root = tree.root().data();
+  for (uint32_t i = 0; i < root->mTableSize; ++i) {
+    const auto* tile = root->tile(i);
+    if (!tile->isChild()) {
+      const nanovdb::Coord tileMin = tile->origin();
+      accumulate(acc, clip, tileMin, tileMin.offsetBy(nanovdb::NanoUpper<BuildT>::DIM - 1),
+                 static_cast<float>(tile->value));
+    }
+  }
+
+  return nanovdb::tools::createNanoGrid(coarse);
+}
+
+}  // namespace
+
+template <typename BuildT>
+DensityPyramid DensityPyramid::build(const nanovdb::NanoGrid<BuildT>& grid, uint32_t levels) {
+  DensityPyramid pyramid;
+  for (uint32_t l = 1; l <= levels; ++l) {
+    pyramid.m_levels.push_back(l == 1 ? downsample(grid) : downsample(pyramid.level(l - 1)));
+  }
+  if (levels > 0) {
+    printf("[Volume] density pyramid: %u levels down to %ux voxels, %.1f MB\n", levels,
+           1u << levels, pyramid.byteSize() / (1024.0 * 1024.0));
+  }
+  return pyramid;
+}
+
+size_t DensityPyramid::byteSize() const {
+  size_t bytes = 0;
+  for (const nanovdb::GridHandle<>& level : m_levels) {
+    bytes += level.size();
+  }
+  return bytes;
+}
+
+template DensityPyramid DensityPyramid::build(const nanovdb::NanoGrid<float>&, uint32_t);
+template DensityPyramid DensityPyramid::build(const nanovdb::NanoGrid<nanovdb::Fp4>&, uint32_t);
+template DensityPyramid DensityPyramid::build(const nanovdb::NanoGrid<nanovdb::Fp8>&, uint32_t);
+template DensityPyramid DensityPyramid::build(const nanovdb::NanoGrid<nanovdb::Fp16>&, uint32_t);
+template DensityPyramid DensityPyramid::build(const nanovdb::NanoGrid<nanovdb::FpN>&, uint32_t);
+
+}  // namespace peacock
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nanovdb/GridHandle.h>
+#include <nanovdb/NanoVDB.h>
+
+namespace peacock {
+
+// Box-filtered float copies of a density grid at 2x, 4x, 8x ... its voxel size, used
+// to shade deep bounces and their shadow rays at a coarser level of detail.
+//
+// Voxel c of level l averages the 2^l-cube of source voxels starting at 2^l * c, so
+// it sits at source index 2^l * c + (2^l - 1) / 2. Every level's map is composed
+// accordingly: a world-space lookup (NanovdbVolume::sample) lands on the same spot of
+// the medium at any level, only the filter footprint grows. Each level is built from
+// the previous one, which keeps the build linear in the source voxel count.
+class DensityPyramid {
+public:
+  // `levels` coarse levels; instantiated for float and the quantized build types.
+  template <typename BuildT>
+  static DensityPyramid build(const nanovdb::NanoGrid<BuildT>& grid, uint32_t levels);
+
+  // Coarse levels, the source grid excluded; level(1) is the first.
+  uint32_t levelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+  const nanovdb::NanoGrid<float>& level(uint32_t l) const { return *m_levels[l - 1].grid<float>(); }
+  const void* data(uint32_t l) const { return m_levels[l - 1].data(); }
+  size_t size(uint32_t l) const { return m_levels[l - 1].size(); }
+
+  size_t byteSize() const;  // all coarse levels
+
+private:
+  std::vector<nanovdb::GridHandle<>> m_levels;
+};
+
+}  // namespace peacock
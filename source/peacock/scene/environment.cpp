@@ -0,0 +1,179 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "peacock/scene/environment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <stb/stb_image.h>
+
+namespace peacock {
+
+namespace {
+
+constexpr float kPi = 3.14159265358979323846f;
+constexpr float kInvPi = 0.31830988618379067154f;
+constexpr float kInv2Pi = 0.15915494309189533577f;
+
+float luminance(const glm::vec3& rgb) {
+  return glm::dot(rgb, glm::vec3(0.212671f, 0.715160f, 0.072169f));
+}
+
+// Normalizes a running sum of `count` weights into a CDF with count + 1 entries.
+// A row without any weight falls back to a uniform CDF. Returns the total.
+float buildCdf(const float* weights, uint32_t count, float* cdf) {
+  cdf[0] = 0.0f;
+  for (uint32_t i = 0; i < count; ++i) {
+    cdf[i + 1] = cdf[i] + weights[i];
+  }
+  const float total = cdf[count];
+  for (uint32_t i = 1; i <= count; ++i) {
+    cdf[i] = total > 0.0f ? cdf[i] / total : static_cast<float>(i) / static_cast<float>(count);
+  }
+  cdf[count] = 1.0f;
+  return total;
+}
+
+// Index i with cdf[i] <= u < cdf[i + 1] (light::EnvironmentLight::find_interval).
+uint32_t findInterval(const float* cdf, uint32_t size, float u) {
+  uint32_t lo = 0;
+  uint32_t hi = size - 1;
+  while (lo + 1 < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (cdf[mid] <= u) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+} // namespace
+
+EnvironmentMap EnvironmentMap::load(const std::filesystem::path& hdrPath) {
+  int width, height, channels;
+  float* data = stbi_loadf(hdrPath.string().c_str(), &width, &height, &channels, 4);
+  if (!data) {
+    throw std::runtime_error("Failed to load HDR image: " + hdrPath.string());
+  }
+
+  EnvironmentMap env;
+  env.width = static_cast<uint32_t>(width);
+  env.height = static_cast<uint32_t>(height);
+  env.pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(data);
+  env.buildDistribution();
+  return env;
+}
+
+void EnvironmentMap::buildDistribution() {
+  const uint32_t w = width;
+  const uint32_t h = height;
+  const uint32_t texelCount = w * h;
+  distribution.assign(static_cast<size_t>(texelCount) + (h + 1) + static_cast<size_t>(h) * (w + 1),
+                      0.0f);
+  float* pdfTable = distribution.data();
+  float* marginal = pdfTable + texelCount;
+  float* conditional = marginal + (h + 1);
+
+  // Radiance is looked up bilinearly, so a texel's weight is the maximum luminance of its
+  // 3x3 neighbourhood; this keeps the pdf non-zero wherever eval() can be non-zero.
+  std::vector<float> weights(texelCount);
+  for (uint32_t y = 0; y < h; ++y) {
+    const float sinTheta = std::sin(kPi * (static_cast<float>(y) + 0.5f) / static_cast<float>(h));
+    for (uint32_t x = 0; x < w; ++x) {
+      float maxLum = 0.0f;
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          maxLum = std::max(maxLum, luminance(texel(static_cast<int>(x) + dx,
+                                                    static_cast<int>(y) + dy)));
+        }
+      }
+      weights[static_cast<size_t>(y) * w + x] = maxLum * sinTheta;
+    }
+  }
+
+  std::vector<float> rowSums(h);
+  for (uint32_t y = 0; y < h; ++y) {
+    rowSums[y] = buildCdf(weights.data() + static_cast<size_t>(y) * w, w,
+                          conditional + static_cast<size_t>(y) * (w + 1));
+  }
+  const float total = buildCdf(rowSums.data(), h, marginal);
+
+  // The pdf over uv of picking texel (x, y) and a uniform point inside it.
+  const float mean = total / static_cast<float>(texelCount);
+  for (uint32_t i = 0; i < texelCount; ++i) {
+    pdfTable[i] = mean > 0.0f ? weights[i] / mean : 1.0f;
+  }
+}
+
+glm::vec3 EnvironmentMap::sampleDirection(glm::vec2 u, float& pdf) const {
+  const float* pdfTable = distribution.data();
+  const float* marginal = pdfTable + static_cast<size_t>(width) * height;
+  const float* conditional = marginal + (height + 1);
+
+  const uint32_t row = findInterval(marginal, height + 1, u.y);
+  const float dv = (u.y - marginal[row]) / std::max(marginal[row + 1] - marginal[row], 1e-12f);
+  const float* rowCdf = conditional + static_cast<size_t>(row) * (width + 1);
+  const uint32_t col = findInterval(rowCdf, width + 1, u.x);
+  const float du = (u.x - rowCdf[col]) / std::max(rowCdf[col + 1] - rowCdf[col], 1e-12f);
+
+  const glm::vec2 uv((static_cast<float>(col) + du) / static_cast<float>(width),
+                     (static_cast<float>(row) + dv) / static_cast<float>(height));
+  const float theta = uv.y * kPi;
+  const float phi = (uv.x - 0.5f) * 2.0f * kPi;
+  const float sinTheta = std::sin(theta);
+
+  const float pdfUv = pdfTable[static_cast<size_t>(row) * width + col];
+  pdf = sinTheta > 0.0f ? pdfUv / (2.0f * kPi * kPi * sinTheta) : 0.0f;
+  return {sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi)};
+}
+
+float EnvironmentMap::pdf(const glm::vec3& dir) const {
+  const glm::vec3 d = glm::normalize(dir);
+  const float phi = std::atan2(d.z, d.x);
+  const float theta = std::asin(std::clamp(d.y, -1.0f, 1.0f));
+  const glm::vec2 uv(phi * kInv2Pi + 0.5f, 0.5f - theta * kInvPi);
+
+  const uint32_t x = std::min(static_cast<uint32_t>(std::max(uv.x, 0.0f) * width), width - 1);
+  const uint32_t y = std::min(static_cast<uint32_t>(std::max(uv.y, 0.0f) * height), height - 1);
+  const float sinTheta = std::sqrt(std::max(1.0f - d.y * d.y, 0.0f));
+  return sinTheta > 0.0f ? distribution[static_cast<size_t>(y) * width + x] /
+                               (2.0f * kPi * kPi * sinTheta)
+                         : 0.0f;
+}
+
+glm::vec3 EnvironmentMap::texel(int x, int y) const {
+  const int w = static_cast<int>(width);
+  const int h = static_cast<int>(height);
+  x = ((x % w) + w) % w;
+  y = ((y % h) + h) % h;
+  const float* p = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+  return {p[0], p[1], p[2]};
+}
+
+glm::vec3 EnvironmentMap::sample(glm::vec2 uv) const {
+  const float x = uv.x * static_cast<float>(width) - 0.5f;
+  const float y = uv.y * static_cast<float>(height) - 0.5f;
+  const float x0 = std::floor(x);
+  const float y0 = std::floor(y);
+  const float fx = x - x0;
+  const float fy = y - y0;
+  const int ix = static_cast<int>(x0);
+  const int iy = static_cast<int>(y0);
+
+  const glm::vec3 top = glm::mix(texel(ix, iy), texel(ix + 1, iy), fx);
+  const glm::vec3 bottom = glm::mix(texel(ix, iy + 1), texel(ix + 1, iy + 1), fx);
+  return glm::mix(top, bottom, fy);
+}
+
+glm::vec3 EnvironmentMap::eval(const glm::vec3& dir) const {
+  const glm::vec3 d = glm::normalize(dir);
+  const float phi = std::atan2(d.z, d.x);
+  const float theta = std::asin(std::clamp(d.y, -1.0f, 1.0f));
+  return sample({phi * kInv2Pi + 0.5f, 0.5f - theta * kInvPi});
+}
+
+}  // namespace peacock
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace peacock {
+
+// Host copy of an equirectangular HDR environment (RGBA32F, rows top to bottom),
+// shared by the GPU upload and the CPU renderer.
+//
+// `distribution` holds the importance-sampling tables for directions drawn
+// proportionally to luminance * sin(theta), in the layout read by
+// light::EnvironmentLight:
+//   [0, W*H)                      pdf over uv per texel (integrates to 1 over [0,1]^2)
+//   [W*H, W*H + H + 1)            marginal CDF over rows
+//   H blocks of W + 1 floats      conditional CDF over the columns of each row
+struct EnvironmentMap {
+  uint32_t width{0};
+  uint32_t height{0};
+  std::vector<float> pixels;
+  std::vector<float> distribution;
+
+  static EnvironmentMap load(const std::filesystem::path& hdrPath);
+
+  size_t byteSize() const { return pixels.size() * sizeof(float); }
+  size_t distributionByteSize() const { return distribution.size() * sizeof(float); }
+
+  // Texel fetch with repeat addressing, matching the linear sampler used on the GPU.
+  glm::vec3 texel(int x, int y) const;
+  // Bilinear lookup at equirectangular coordinates uv in [0, 1]^2.
+  glm::vec3 sample(glm::vec2 uv) const;
+  // Radiance arriving from world-space direction `dir` (same mapping as
+  // light::EnvironmentLight::dir_to_uv).
+  glm::vec3 eval(const glm::vec3& dir) const;
+
+  // Importance-sampled direction for u in [0, 1)^2; `pdf` is per solid angle.
+  glm::vec3 sampleDirection(glm::vec2 u, float& pdf) const;
+  // Solid-angle density of sampleDirection for `dir`.
+  float pdf(const glm::vec3& dir) const;
+
+private:
+  void buildDistribution();
+};
+
+}  // namespace peacock
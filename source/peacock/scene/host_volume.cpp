@@ -0,0 +1,182 @@
+#include "peacock/scene/host_volume.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <stdexcept>
+#include <system_error>
+
+#include "peacock/common/process_memory.h"
+#include "peacock/scene/volume.h"
+
+namespace peacock {
+
+namespace {
+
+constexpr char kSidecarMagic[8] = {'P', 'K', 'N', 'V', 'D', 'B', '\0', '\0'};
+constexpr uint32_t kSidecarVersion = 2;
+
+// 64 bytes, so the grid that follows keeps NanoVDB's 32-byte data alignment
+// relative to the page-aligned mapping.
+struct SidecarHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  uint64_t pathHash;     // hash of the absolute source path
+  int64_t sourceMtime;   // source last_write_time, clock ticks
+  uint64_t sourceSize;   // source file size in bytes
+  uint64_t gridSize;     // bytes of NanoVDB data after the header
+  uint32_t gridType;     // nanovdb::GridType of the stored grid
+  float tolerance;       // FpN error bound the grid was built with
+  uint64_t reserved;
+};
+static_assert(sizeof(SidecarHeader) == 64);
+static_assert(sizeof(SidecarHeader) % NANOVDB_DATA_ALIGNMENT == 0);
+
+SidecarHeader makeHeader(const std::filesystem::path& vdbPath, const VolumeLoadOptions& options) {
+  SidecarHeader header{};
+  std::memcpy(header.magic, kSidecarMagic, sizeof(kSidecarMagic));
+  header.version = kSidecarVersion;
+  header.headerSize = sizeof(SidecarHeader);
+  header.pathHash = std::hash<std::string>{}(std::filesystem::absolute(vdbPath).lexically_normal().string());
+  header.sourceMtime = static_cast<int64_t>(
+      std::filesystem::last_write_time(vdbPath).time_since_epoch().count());
+  header.sourceSize = static_cast<uint64_t>(std::filesystem::file_size(vdbPath));
+  header.gridType = static_cast<uint32_t>(volumePrecisionGridType(options.precision));
+  header.tolerance = options.precision == VolumePrecision::eFpN ? options.tolerance : 0.0f;
+  return header;
+}
+
+// The sidecar is valid if it was written from this exact source file with the same
+// precision settings and holds a complete grid of that type.
+bool isSidecarValid(const MappedFile& mapped, const SidecarHeader& expected) {
+  if (mapped.size() < sizeof(SidecarHeader)) {
+    return false;
+  }
+  SidecarHeader header;
+  std::memcpy(&header, mapped.data(), sizeof(header));
+  if (std::memcmp(header.magic, kSidecarMagic, sizeof(kSidecarMagic)) != 0 ||
+      header.version != kSidecarVersion || header.headerSize != sizeof(SidecarHeader) ||
+      header.pathHash != expected.pathHash || header.sourceMtime != expected.sourceMtime ||
+      header.sourceSize != expected.sourceSize || header.gridType != expected.gridType ||
+      header.tolerance != expected.tolerance ||
+      mapped.size() != sizeof(SidecarHeader) + header.gridSize) {
+    return false;
+  }
+  const auto* grid =
+      reinterpret_cast<const nanovdb::GridData*>(mapped.data() + sizeof(SidecarHeader));
+  return header.gridSize >= sizeof(nanovdb::GridData) && grid->isValid() &&
+         static_cast<uint32_t>(grid->mGridType) == expected.gridType && grid->mGridSize == header.gridSize;
+}
+
+// Writes to a temporary file and renames it into place so a crash never leaves
+// a truncated sidecar behind.
+void writeSidecar(const std::filesystem::path& path, SidecarHeader header, const void* grid,
+                  size_t gridSize) {
+  header.gridSize = gridSize;
+  std::filesystem::path tmpPath = path;
+  tmpPath += ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("Failed to open volume cache for writing: " + tmpPath.string());
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(static_cast<const char*>(grid), static_cast<std::streamsize>(gridSize));
+    if (!file) {
+      throw std::runtime_error("Failed to write volume cache: " + tmpPath.string());
+    }
+  }
+  std::filesystem::rename(tmpPath, path);
+}
+
+} // namespace
+
+std::filesystem::path HostVolume::sidecarPath(const std::filesystem::path& vdbPath,
+                                              VolumePrecision precision) {
+  // One sidecar per precision, so switching formats does not evict the others.
+  std::filesystem::path path = vdbPath;
+  if (precision != VolumePrecision::eFloat) {
+    path += std::string(".") + volumePrecisionName(precision);
+  }
+  path += ".nvdb";
+  return path;
+}
+
+size_t HostVolume::floatEquivalentSize() const {
+  return visit([this](const auto& grid) -> size_t {
+    // Leaves are stored last (no blind data is written), so everything from the first
+    // leaf on is leaf storage; only that part depends on the value encoding.
+    const auto& tree = grid.tree();
+    if (tree.nodeCount(0) == 0) {
+      return m_size;
+    }
+    const size_t leafOffset = reinterpret_cast<const uint8_t*>(tree.getFirstLeaf()) - m_data;
+    return leafOffset + tree.nodeCount(0) * sizeof(nanovdb::NanoLeaf<float>);
+  });
+}
+
+HostVolume HostVolume::load(const std::filesystem::path& vdbPath, const VolumeLoadOptions& options) {
+  if (!std::filesystem::exists(vdbPath)) {
+    throw std::runtime_error("Volume file does not exist: " + vdbPath.string());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const std::filesystem::path cachePath = sidecarPath(vdbPath, options.precision);
+  const SidecarHeader expected = makeHeader(vdbPath, options);
+
+  HostVolume volume;
+  if (options.useCache && std::filesystem::exists(cachePath)) {
+    try {
+      MappedFile mapped(cachePath);
+      if (isSidecarValid(mapped, expected)) {
+        volume.m_mapped = std::move(mapped);
+        volume.m_data = volume.m_mapped.data() + sizeof(SidecarHeader);
+        volume.m_size = volume.m_mapped.size() - sizeof(SidecarHeader);
+      } else {
+        printf("[Volume] stale cache %s, rebuilding\n", cachePath.string().c_str());
+      }
+    } catch (const std::exception& e) {
+      printf("[Volume] ignoring cache: %s\n", e.what());
+    }
+  }
+
+  if (!volume.fromCache()) {
+    volume.m_handle = loadNanoVolume(vdbPath, options.precision, options.tolerance);
+    volume.m_data = static_cast<const uint8_t*>(volume.m_handle.data());
+    volume.m_size = volume.m_handle.gridSize();
+
+    if (options.useCache) {
+      try {
+        writeSidecar(cachePath, expected, volume.m_data, volume.m_size);
+      } catch (const std::exception& e) {
+        // A read-only asset directory only costs the next start-up time.
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(cachePath) += ".tmp", ec);
+        printf("[Volume] could not write cache: %s\n", e.what());
+      }
+    }
+  }
+
+  const double ms =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  printf("[Volume] %s: %.1f MB %s %s in %.1f ms, peak RSS %.1f MB\n",
+         vdbPath.filename().string().c_str(), volume.m_size / (1024.0 * 1024.0),
+         volumePrecisionName(options.precision),
+         volume.fromCache() ? "mapped from cache" : "converted", ms,
+         peakResidentBytes() / (1024.0 * 1024.0));
+  if (options.precision != VolumePrecision::eFloat) {
+    const size_t floatSize = volume.floatEquivalentSize();
+    printf("[Volume] %s saves %.1f MB vs float (%.1f%% of %.1f MB)\n",
+           volumePrecisionName(options.precision),
+           (static_cast<double>(floatSize) - volume.m_size) / (1024.0 * 1024.0),
+           100.0 * volume.m_size / std::max<size_t>(floatSize, 1), floatSize / (1024.0 * 1024.0));
+  }
+  return volume;
+}
+
+}  // namespace peacock
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include <nanovdb/GridHandle.h>
+#include <nanovdb/NanoVDB.h>
+
+#include "peacock/common/mapped_file.h"
+#include "peacock/render_settings.h"
+#include "peacock/scene/volume.h"
+
+namespace peacock {
+
+struct VolumeLoadOptions {
+  bool useCache{true};
+  VolumePrecision precision{VolumePrecision::eFloat};
+  float tolerance{0.001f};  // FpN absolute error bound
+
+  static VolumeLoadOptions fromSettings(const RaytracerSettings& settings) {
+    return {settings.volumeCache, parseVolumePrecision(settings.volumePrecision),
+            settings.volumeTolerance};
+  }
+};
+
+// A NanoVDB density grid (float or quantized) resident in host memory, ready to be
+// copied to the GPU.
+//
+// load() first looks for a `<source>[.<precision>].nvdb` sidecar next to the OpenVDB
+// file. The sidecar is a small header (source path hash, mtime and size, precision)
+// followed by the raw grid bytes; on a hit it is memory-mapped and used in place, so
+// neither OpenVDB nor a heap copy of the grid is involved. On a miss the grid is
+// converted with OpenVDB and the sidecar is (re)written for the next run.
+class HostVolume {
+public:
+  static HostVolume load(const std::filesystem::path& vdbPath,
+                         const VolumeLoadOptions& options = {});
+
+  nanovdb::GridType gridType() const {
+    return reinterpret_cast<const nanovdb::GridData*>(m_data)->mGridType;
+  }
+  template <typename BuildT>
+  const nanovdb::NanoGrid<BuildT>* grid() const {
+    return gridType() == nanovdb::toGridType<BuildT>()
+               ? reinterpret_cast<const nanovdb::NanoGrid<BuildT>*>(m_data)
+               : nullptr;
+  }
+  // Calls fn(const nanovdb::NanoGrid<BuildT>&) with the grid's concrete build type.
+  template <typename Fn>
+  decltype(auto) visit(Fn&& fn) const {
+    switch (gridType()) {
+      case nanovdb::GridType::Fp4:  return fn(*grid<nanovdb::Fp4>());
+      case nanovdb::GridType::Fp8:  return fn(*grid<nanovdb::Fp8>());
+      case nanovdb::GridType::Fp16: return fn(*grid<nanovdb::Fp16>());
+      case nanovdb::GridType::FpN:  return fn(*grid<nanovdb::FpN>());
+      default:                      return fn(*grid<float>());
+    }
+  }
+
+  const void* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool fromCache() const { return m_mapped.isOpen(); }
+
+  // Bytes the same tree would take with 32-bit float leaves, for reporting savings.
+  size_t floatEquivalentSize() const;
+
+  static std::filesystem::path sidecarPath(const std::filesystem::path& vdbPath,
+                                           VolumePrecision precision);
+
+private:
+  nanovdb::GridHandle<> m_handle;  // converted grid (cache miss)
+  MappedFile m_mapped;             // sidecar mapping (cache hit)
+  const uint8_t* m_data{nullptr};
+  size_t m_size{0};
+};
+
+}  // namespace peacock
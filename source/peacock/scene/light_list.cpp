@@ -0,0 +1,108 @@
+#include "peacock/scene/light_list.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "peacock/scene/environment.h"
+
+namespace peacock {
+
+namespace {
+
+constexpr float kPi = 3.14159265358979323846f;
+
+float luminance(const glm::vec3& rgb) {
+  return glm::dot(rgb, glm::vec3(0.212671f, 0.715160f, 0.072169f));
+}
+
+// Luminance integrated over the sphere of directions (texel centers).
+float integrateEnvironment(const EnvironmentMap& env) {
+  const float texelSolidAngle = (2.0f * kPi / static_cast<float>(env.width)) *
+                                (kPi / static_cast<float>(env.height));
+  double sum = 0.0;
+  for (uint32_t y = 0; y < env.height; ++y) {
+    const float sinTheta =
+        std::sin(kPi * (static_cast<float>(y) + 0.5f) / static_cast<float>(env.height));
+    for (uint32_t x = 0; x < env.width; ++x) {
+      sum += luminance(env.texel(static_cast<int>(x), static_cast<int>(y))) * sinTheta;
+    }
+  }
+  return static_cast<float>(sum) * texelSolidAngle;
+}
+
+float lightArea(const shaderio::LightDesc& light) {
+  switch (light.type) {
+    case shaderio::eLightRectangle: return 4.0f * glm::length(light.p1) * glm::length(light.p2);
+    case shaderio::eLightDisk:      return kPi * glm::length(light.p1) * glm::length(light.p2);
+    case shaderio::eLightTriangle:
+      return 0.5f * glm::length(glm::cross(light.p1 - light.p0, light.p2 - light.p0));
+    default: return 0.0f;
+  }
+}
+
+// Vose's alias method: entry i is kept with probability aliasProb, otherwise its alias
+// is taken, which makes every light come out with probability pmf from one uniform.
+void buildAliasTable(std::vector<shaderio::LightDesc>& lights, const std::vector<float>& power) {
+  const size_t n = lights.size();
+  double total = 0.0;
+  for (float p : power) {
+    total += p;
+  }
+
+  std::vector<float> scaled(n);
+  std::vector<uint32_t> small, large;
+  for (size_t i = 0; i < n; ++i) {
+    // Without any power estimate (black environment, no lights) pick uniformly
+    lights[i].pmf = total > 0.0 ? static_cast<float>(power[i] / total) : 1.0f / static_cast<float>(n);
+    scaled[i] = lights[i].pmf * static_cast<float>(n);
+    (scaled[i] < 1.0f ? small : large).push_back(static_cast<uint32_t>(i));
+  }
+  while (!small.empty() && !large.empty()) {
+    const uint32_t s = small.back();
+    const uint32_t l = large.back();
+    small.pop_back();
+    large.pop_back();
+    lights[s].aliasProb = scaled[s];
+    lights[s].alias = l;
+    scaled[l] -= 1.0f - scaled[s];
+    (scaled[l] < 1.0f ? small : large).push_back(l);
+  }
+  // Leftovers are 1 up to rounding
+  for (uint32_t i : small) {
+    lights[i].aliasProb = 1.0f;
+    lights[i].alias = i;
+  }
+  for (uint32_t i : large) {
+    lights[i].aliasProb = 1.0f;
+    lights[i].alias = i;
+  }
+}
+
+}  // namespace
+
+LightList LightList::build(const std::vector<shaderio::LightDesc>& sceneLights,
+                           const EnvironmentMap& environment, const glm::vec3& sceneMin,
+                           const glm::vec3& sceneMax) {
+  const float radius = 0.5f * glm::length(sceneMax - sceneMin);
+  const float sceneDisk = kPi * radius * radius;
+
+  LightList list;
+  list.lights.reserve(sceneLights.size() + 1);
+  list.lights.push_back({});  // eLightEnvironment
+  list.power.push_back(sceneDisk * integrateEnvironment(environment));
+  for (const shaderio::LightDesc& light : sceneLights) {
+    list.lights.push_back(light);
+    list.power.push_back(light.type == shaderio::eLightDirectional
+                             ? sceneDisk * luminance(light.radiance)
+                             : 2.0f * kPi * lightArea(light) * luminance(light.radiance));
+  }
+  buildAliasTable(list.lights, list.power);
+
+  if (!sceneLights.empty()) {
+    printf("[Lights] %u lights, environment selected with p = %.3f\n", list.count(),
+           list.lights.front().pmf);
+  }
+  return list;
+}
+
+}  // namespace peacock
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "peacock/shaderio.h"
+
+namespace peacock {
+
+struct EnvironmentMap;
+
+// The light list uploaded to eLights: the environment at index 0, then the scene
+// lights, each entry carrying its row of a Walker alias table over the light powers.
+// NEE picks one light per scatter event in O(1), so the shadow-ray count does not
+// grow with the number of lights.
+//
+// Powers are luminance estimates in the spirit of PBRT: area lights emit pi * A * L
+// per side, and the environment and directional lights are measured through the
+// disk of the scene's bounding sphere, pi * R^2 * (integral of L over the sphere, or
+// the irradiance). They steer the selection only; any positive value stays unbiased.
+struct LightList {
+  std::vector<shaderio::LightDesc> lights;
+  std::vector<float> power;  // per entry of `lights`
+
+  static LightList build(const std::vector<shaderio::LightDesc>& sceneLights,
+                         const EnvironmentMap& environment, const glm::vec3& sceneMin,
+                         const glm::vec3& sceneMax);
+
+  uint32_t count() const { return static_cast<uint32_t>(lights.size()); }
+  size_t byteSize() const { return lights.size() * sizeof(shaderio::LightDesc); }
+};
+
+}  // namespace peacock
@@ -0,0 +1,228 @@
+#include "peacock/scene/majorant_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+namespace peacock {
+
+namespace {
+
+// Raises the bound of every cell that a block of voxels [voxelMin, voxelMax]
+// (inclusive) can influence. Trilinear lookups at continuous index x read voxels
+// floor(x) and floor(x) + 1, so a voxel v contributes to positions in (v - 1, v + 1).
+void splat(const MajorantGrid& grid, std::vector<float>& bounds, const nanovdb::Coord& voxelMin,
+           const nanovdb::Coord& voxelMax, float value) {
+  if (value <= 0.0f) {
+    return;
+  }
+  glm::ivec3 lo, hi;
+  for (int axis = 0; axis < 3; ++axis) {
+    const float cellSize = static_cast<float>(grid.cellSize);
+    const float a = (static_cast<float>(voxelMin[axis] - 1) - grid.origin[axis]) / cellSize;
+    const float b = (static_cast<float>(voxelMax[axis] + 1) - grid.origin[axis]) / cellSize;
+    const int last = static_cast<int>(grid.resolution[axis]) - 1;
+    lo[axis] = std::clamp(static_cast<int>(std::floor(a)), 0, last);
+    hi[axis] = std::clamp(static_cast<int>(std::floor(b)), 0, last);
+  }
+
+  for (int z = lo.z; z <= hi.z; ++z) {
+    for (int y = lo.y; y <= hi.y; ++y) {
+      for (int x = lo.x; x <= hi.x; ++x) {
+        float& cell =
+            bounds[(static_cast<size_t>(z) * grid.resolution.y + y) * grid.resolution.x + x];
+        cell = std::max(cell, value);
+      }
+    }
+  }
+}
+
+// Adds `value` once for every voxel of [voxelMin, voxelMax] (inclusive) to the sum
+// of the cell holding it. Unlike the bounds, means ignore the trilinear footprint.
+void accumulate(const MajorantGrid& grid, std::vector<double>& sums, const nanovdb::Coord& voxelMin,
+                const nanovdb::Coord& voxelMax, float value) {
+  if (value == 0.0f) {
+    return;
+  }
+  const int cellSize = static_cast<int>(grid.cellSize);
+  glm::ivec3 lo, hi, first, last;
+  for (int axis = 0; axis < 3; ++axis) {
+    first[axis] = std::max(voxelMin[axis] - static_cast<int>(grid.origin[axis]), 0);
+    last[axis] = std::min(voxelMax[axis] - static_cast<int>(grid.origin[axis]),
+                          static_cast<int>(grid.resolution[axis]) * cellSize - 1);
+    if (first[axis] > last[axis]) {
+      return;
+    }
+    lo[axis] = first[axis] / cellSize;
+    hi[axis] = last[axis] / cellSize;
+  }
+
+  // Voxels of the block inside cell `c` along one axis
+  auto overlap = [&](int axis, int c) {
+    return std::min(last[axis], (c + 1) * cellSize - 1) - std::max(first[axis], c * cellSize) + 1;
+  };
+  for (int z = lo.z; z <= hi.z; ++z) {
+    for (int y = lo.y; y <= hi.y; ++y) {
+      for (int x = lo.x; x <= hi.x; ++x) {
+        const double voxels = static_cast<double>(overlap(0, x)) * overlap(1, y) * overlap(2, z);
+        sums[(static_cast<size_t>(z) * grid.resolution.y + y) * grid.resolution.x + x] +=
+            voxels * value;
+      }
+    }
+  }
+}
+
+// Walks every leaf and constant-value tile of the tree; tiles behave like dense
+// blocks of voxels. Leaves are reached through their parents because FpN leaves
+// vary in size and cannot be indexed as an array.
+template <typename BuildT, typename LeafFn, typename TileFn>
+void visitTree(const nanovdb::NanoGrid<BuildT>& grid, LeafFn&& onLeaf, TileFn&& onTile) {
+  auto visitTiles = [&](const auto& node) {
+    using ChildT = typename std::decay_t<decltype(node)>::ChildNodeType;
+    const auto* data = node.data();
+    for (uint32_t n = 0; n < node.SIZE; ++n) {
+      if (!data->mChildMask.isOn(n)) {
+        const nanovdb::Coord tileMin = node.offsetToGlobalCoord(n);
+        onTile(tileMin, tileMin.offsetBy(ChildT::DIM - 1), static_cast<float>(data->mTable[n].value));
+      }
+    }
+  };
+
+  const auto& tree = grid.tree();
+  const auto* lowers = tree.getFirstLower();
+  for (uint32_t i = 0; i < tree.nodeCount(1); ++i) {
+    const auto& lower = lowers[i];
+    for (uint32_t n = 0; n < lower.SIZE; ++n) {
+      if (lower.data()->mChildMask.isOn(n)) {
+        onLeaf(*lower.getChild(n));
+      }
+    }
+    visitTiles(lower);
+  }
+  const auto* uppers = tree.getFirstUpper();
+  for (uint32_t i = 0; i < tree.nodeCount(2); ++i) {
+    visitTiles(uppers[i]);
+  }
+  const auto* root = tree.root().data();
+  for (uint32_t i = 0; i < root->mTableSize; ++i) {
+    const auto* tile = root->tile(i);
+    if (!tile->isChild()) {
+      const nanovdb::Coord tileMin = tile->origin();
+      onTile(tileMin, tileMin.offsetBy(nanovdb::NanoUpper<BuildT>::DIM - 1),
+             static_cast<float>(tile->value));
+    }
+  }
+}
+
+} // namespace
+
+template <typename BuildT>
+MajorantGrid MajorantGrid::build(const nanovdb::NanoGrid<BuildT>& grid, uint32_t cellSize) {
+  MajorantGrid majorants;
+  majorants.cellSize = std::max(cellSize, 1u);
+
+  // Cover the active index bbox plus the one-voxel trilinear footprint on each side.
+  const nanovdb::CoordBBox bbox = grid.indexBBox();
+  for (int axis = 0; axis < 3; ++axis) {
+    const int extent = bbox.max()[axis] - bbox.min()[axis] + 3;
+    majorants.origin[axis] = static_cast<float>(bbox.min()[axis] - 1);
+    majorants.resolution[axis] =
+        std::max(1u, (static_cast<uint32_t>(extent) + majorants.cellSize - 1) / majorants.cellSize);
+  }
+  majorants.maxDensity.assign(static_cast<size_t>(majorants.resolution.x) *
+                                  majorants.resolution.y * majorants.resolution.z,
+                              0.0f);
+  std::vector<double> sums(majorants.cellCount(), 0.0);
+
+  // The bound covers all 512 values of a leaf, active or not, because the shader
+  // reads inactive voxels too.
+  visitTree(
+      grid,
+      [&](const auto& leaf) {
+        float leafMax = 0.0f;
+        for (uint32_t v = 0; v < leaf.SIZE; ++v) {
+          const float value = static_cast<float>(leaf.getValue(v));
+          leafMax = std::max(leafMax, value);
+          const nanovdb::Coord voxel = leaf.offsetToGlobalCoord(v);
+          accumulate(majorants, sums, voxel, voxel, value);
+        }
+        splat(majorants, majorants.maxDensity, leaf.origin(), leaf.origin().offsetBy(leaf.DIM - 1),
+              leafMax);
+      },
+      [&](const nanovdb::Coord& tileMin, const nanovdb::Coord& tileMax, float value) {
+        splat(majorants, majorants.maxDensity, tileMin, tileMax, value);
+        accumulate(majorants, sums, tileMin, tileMax, value);
+      });
+
+  // Trilinear interpolation stays within [min, max] of the voxels it reads, so the
+  // mean never exceeds the bound; the clamp only absorbs rounding.
+  const double voxelsPerCell = std::pow(static_cast<double>(majorants.cellSize), 3.0);
+  majorants.meanDensity.resize(majorants.cellCount());
+  for (size_t c = 0; c < majorants.cellCount(); ++c) {
+    majorants.meanDensity[c] =
+        std::clamp(static_cast<float>(sums[c] / voxelsPerCell), 0.0f, majorants.maxDensity[c]);
+  }
+
+  const size_t emptyCells =
+      std::count(majorants.maxDensity.begin(), majorants.maxDensity.end(), 0.0f);
+  float sum = 0.0f;
+  float meanSum = 0.0f;
+  for (size_t c = 0; c < majorants.cellCount(); ++c) {
+    sum += majorants.maxDensity[c];
+    meanSum += majorants.meanDensity[c];
+  }
+  const float globalMax = static_cast<float>(grid.tree().root().maximum());
+  printf("[Volume] majorant grid %ux%ux%u (cell %u voxels): %.1f%% empty, mean/global bound %.3f, "
+         "cell mean/bound %.3f\n",
+         majorants.resolution.x, majorants.resolution.y, majorants.resolution.z,
+         majorants.cellSize, 100.0 * emptyCells / majorants.cellCount(),
+         globalMax > 0.0f ? sum / majorants.cellCount() / globalMax : 0.0f,
+         sum > 0.0f ? meanSum / sum : 0.0f);
+  return majorants;
+}
+
+void MajorantGrid::addLevel(const nanovdb::NanoGrid<float>& level, uint32_t scale) {
+  // Level voxel c sits at source index scale * c + (scale - 1) / 2 and its trilinear
+  // footprint spans `scale` source voxels to either side; splat() adds one more.
+  const int s = static_cast<int>(scale);
+  auto toSource = [s](const nanovdb::Coord& lo, const nanovdb::Coord& hi) {
+    return std::pair{nanovdb::Coord(s * lo[0] - s / 2, s * lo[1] - s / 2, s * lo[2] - s / 2),
+                     nanovdb::Coord(s * hi[0] + 3 * s / 2 - 1, s * hi[1] + 3 * s / 2 - 1,
+                                    s * hi[2] + 3 * s / 2 - 1)};
+  };
+
+  std::vector<float>& bounds = lodMaxDensity.emplace_back(cellCount(), 0.0f);
+  visitTree(
+      level,
+      [&](const auto& leaf) {
+        float leafMax = 0.0f;
+        for (uint32_t v = 0; v < leaf.SIZE; ++v) {
+          leafMax = std::max(leafMax, leaf.getValue(v));
+        }
+        const auto [lo, hi] = toSource(leaf.origin(), leaf.origin().offsetBy(leaf.DIM - 1));
+        splat(*this, bounds, lo, hi, leafMax);
+      },
+      [&](const nanovdb::Coord& tileMin, const nanovdb::Coord& tileMax, float value) {
+        const auto [lo, hi] = toSource(tileMin, tileMax);
+        splat(*this, bounds, lo, hi, value);
+      });
+}
+
+void MajorantGrid::pack(float* dst) const {
+  for (uint32_t l = 0; l < levelCount(); ++l) {
+    const std::vector<float>& bounds = l == 0 ? maxDensity : lodMaxDensity[l - 1];
+    std::copy(bounds.begin(), bounds.end(), dst);
+    std::copy(meanDensity.begin(), meanDensity.end(), dst + cellCount());
+    dst += 2 * cellCount();
+  }
+}
+
+template MajorantGrid MajorantGrid::build(const nanovdb::NanoGrid<float>&, uint32_t);
+template MajorantGrid MajorantGrid::build(const nanovdb::NanoGrid<nanovdb::Fp4>&, uint32_t);
+template MajorantGrid MajorantGrid::build(const nanovdb::NanoGrid<nanovdb::Fp8>&, uint32_t);
+template MajorantGrid MajorantGrid::build(const nanovdb::NanoGrid<nanovdb::Fp16>&, uint32_t);
+template MajorantGrid MajorantGrid::build(const nanovdb::NanoGrid<nanovdb::FpN>&, uint32_t);
+
+}  // namespace peacock
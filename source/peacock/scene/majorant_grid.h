@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <nanovdb/NanoVDB.h>
+
+#include "peacock/shaderio.h"
+
+namespace peacock {
+
+// Coarse grid of conservative density bounds over a NanoVDB float grid, in index
+// space. Each cell stores the maximum raw voxel value that trilinear interpolation
+// can reach inside it, so the medium majorant of a cell is
+//   (sigma_a + sigma_s) * densityScale * maxDensity[cell].
+// Cells whose bound is zero are skipped entirely by the DDA majorant iterator.
+//
+// Each cell also stores the mean raw voxel value inside it, the control density of
+// residual ratio tracking. On the GPU both arrays share one buffer: the bounds of
+// all cells, then their means.
+//
+// The coarse levels of a DensityPyramid get bounds of their own, laid over the same
+// cells of the source grid's index space, so one DDA walk serves every level. Each
+// level follows the previous one in the buffer with its bounds and the shared means.
+struct MajorantGrid {
+  glm::vec3 origin{0.0f};       // index-space position of cell (0, 0, 0)
+  uint32_t cellSize{16};        // cell edge in voxels
+  glm::uvec3 resolution{0u};    // cells per axis
+  std::vector<float> maxDensity;   // x fastest, then y, then z
+  std::vector<float> meanDensity;  // same layout
+  std::vector<std::vector<float>> lodMaxDensity;  // bounds of pyramid levels 1, 2, ...
+
+  // `cellSize` is the user-facing resolution knob; leaves are 8^3 voxels, so
+  // multiples of 8 keep the bounds tight. Instantiated for float and the quantized
+  // build types, whose leaves decode to float.
+  template <typename BuildT>
+  static MajorantGrid build(const nanovdb::NanoGrid<BuildT>& grid, uint32_t cellSize);
+
+  // Fills the majorantGrid* fields the shader needs to address the cell buffer.
+  void describe(shaderio::VolumeDesc& desc) const {
+    desc.majorantGridMin  = origin;
+    desc.majorantCellSize = static_cast<float>(cellSize);
+    desc.majorantGridRes  = resolution;
+  }
+
+  // Bounds of the next pyramid level, whose voxels span `scale` source voxels.
+  void addLevel(const nanovdb::NanoGrid<float>& level, uint32_t scale);
+
+  // Writes the GPU layout, floatCount() values: per level the bounds, then the means.
+  void pack(float* dst) const;
+
+  uint32_t levelCount() const { return 1 + static_cast<uint32_t>(lodMaxDensity.size()); }
+  size_t cellCount() const { return maxDensity.size(); }
+  size_t floatCount() const { return 2 * cellCount() * levelCount(); }
+  size_t byteSize() const { return floatCount() * sizeof(float); }
+};
+
+}  // namespace peacock
@@ -0,0 +1,156 @@
+#include "peacock/scene/volume.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <openvdb/openvdb.h>
+#include <nanovdb/tools/CreateNanoGrid.h>
+
+namespace peacock {
+
+namespace {
+
+glm::mat4 makeWorldToIndexMatrix(const nanovdb::Map& map) {
+  const float tx = -(map.mVecF[0] * map.mInvMatF[0] + map.mVecF[1] * map.mInvMatF[3] +
+                     map.mVecF[2] * map.mInvMatF[6]);
+  const float ty = -(map.mVecF[0] * map.mInvMatF[1] + map.mVecF[1] * map.mInvMatF[4] +
+                     map.mVecF[2] * map.mInvMatF[7]);
+  const float tz = -(map.mVecF[0] * map.mInvMatF[2] + map.mVecF[1] * map.mInvMatF[5] +
+                     map.mVecF[2] * map.mInvMatF[8]);
+
+  return glm::mat4(
+      map.mInvMatF[0], map.mInvMatF[3], map.mInvMatF[6], 0.0f,
+      map.mInvMatF[1], map.mInvMatF[4], map.mInvMatF[7], 0.0f,
+      map.mInvMatF[2], map.mInvMatF[5], map.mInvMatF[8], 0.0f,
+      tx, ty, tz, 1.0f);
+}
+
+openvdb::FloatGrid::Ptr loadFirstFloatGrid(const std::filesystem::path& vdbPath) {
+  openvdb::initialize();
+
+  openvdb::io::File file(vdbPath.string());
+  file.open();
+
+  openvdb::FloatGrid::Ptr floatGrid;
+  for (auto it = file.beginName(); it != file.endName(); ++it) {
+    auto gridBase = file.readGrid(*it);
+    floatGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(gridBase);
+    if (floatGrid) {
+      break;
+    }
+  }
+
+  file.close();
+
+  if (!floatGrid) {
+    throw std::runtime_error("No float grid found in VDB file: " + vdbPath.string());
+  }
+
+  return floatGrid;
+}
+
+} // namespace
+
+VolumePrecision parseVolumePrecision(const std::string& name) {
+  for (VolumePrecision precision : {VolumePrecision::eFloat, VolumePrecision::eFp16,
+                                    VolumePrecision::eFp8, VolumePrecision::eFp4,
+                                    VolumePrecision::eFpN}) {
+    if (name == volumePrecisionName(precision)) {
+      return precision;
+    }
+  }
+  throw std::runtime_error("Unknown volume precision (expected float, fp16, fp8, fp4 or fpn): " +
+                           name);
+}
+
+const char* volumePrecisionName(VolumePrecision precision) {
+  switch (precision) {
+    case VolumePrecision::eFp16: return "fp16";
+    case VolumePrecision::eFp8:  return "fp8";
+    case VolumePrecision::eFp4:  return "fp4";
+    case VolumePrecision::eFpN:  return "fpn";
+    default:                     return "float";
+  }
+}
+
+nanovdb::GridType volumePrecisionGridType(VolumePrecision precision) {
+  switch (precision) {
+    case VolumePrecision::eFp16: return nanovdb::GridType::Fp16;
+    case VolumePrecision::eFp8:  return nanovdb::GridType::Fp8;
+    case VolumePrecision::eFp4:  return nanovdb::GridType::Fp4;
+    case VolumePrecision::eFpN:  return nanovdb::GridType::FpN;
+    default:                     return nanovdb::GridType::Float;
+  }
+}
+
+nanovdb::GridHandle<> loadNanoVolume(const std::filesystem::path& vdbPath,
+                                     VolumePrecision precision, float tolerance) {
+  if (!std::filesystem::exists(vdbPath)) {
+    throw std::runtime_error("Volume file does not exist: " + vdbPath.string());
+  }
+
+  auto floatGrid = loadFirstFloatGrid(vdbPath);
+  nanovdb::GridHandle<> handle;
+  switch (precision) {
+    case VolumePrecision::eFp16:
+      handle = nanovdb::tools::createNanoGrid<openvdb::FloatGrid, nanovdb::Fp16>(*floatGrid);
+      break;
+    case VolumePrecision::eFp8:
+      handle = nanovdb::tools::createNanoGrid<openvdb::FloatGrid, nanovdb::Fp8>(*floatGrid);
+      break;
+    case VolumePrecision::eFp4:
+      handle = nanovdb::tools::createNanoGrid<openvdb::FloatGrid, nanovdb::Fp4>(*floatGrid);
+      break;
+    case VolumePrecision::eFpN:
+      handle = nanovdb::tools::createNanoGrid<openvdb::FloatGrid, nanovdb::FpN>(
+          *floatGrid, nanovdb::tools::StatsMode::Default, nanovdb::CheckMode::Default,
+          /*ditherOn=*/false, /*verbose=*/0, nanovdb::tools::AbsDiff(tolerance));
+      break;
+    default:
+      handle = nanovdb::tools::createNanoGrid(*floatGrid);
+      break;
+  }
+
+  if (handle.gridType() != volumePrecisionGridType(precision)) {
+    throw std::runtime_error("Failed to convert VDB float grid to NanoVDB: " +
+                             vdbPath.string());
+  }
+  if (handle.data() == nullptr) {
+    throw std::runtime_error("NanoVDB handle does not contain raw grid data: " +
+                             vdbPath.string());
+  }
+  return handle;
+}
+
+template <typename BuildT>
+shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<BuildT>& grid) {
+  shaderio::VolumeDesc desc{};
+  desc.worldToIndex = glm::transpose(makeWorldToIndexMatrix(grid.map()));
+
+  const auto bbox = grid.worldBBox();
+  printf("[Volume] worldBBox min=(%.4f, %.4f, %.4f) max=(%.4f, %.4f, %.4f)\n",
+         bbox.min()[0], bbox.min()[1], bbox.min()[2],
+         bbox.max()[0], bbox.max()[1], bbox.max()[2]);
+  desc.bboxMin = glm::vec3(bbox.min()[0], bbox.min()[1], bbox.min()[2]);
+  desc.bboxMax = glm::vec3(bbox.max()[0], bbox.max()[1], bbox.max()[2]);
+
+  desc.sigma_a      = glm::vec3(0.0f);        // pure-scattering smoke: no absorption
+  desc.sigma_s      = glm::vec3(1.0f);        // unit scattering scale
+  desc.Le           = glm::vec3(0.0f);        // non-emissive
+  desc.densityScale = 0.1f;
+  desc.g            = 0.0f;                   // isotropic
+  desc.stepSize     = 0.5f;
+
+  const float maxDensity = static_cast<float>(grid.tree().root().maximum());
+  desc.majorant = std::max(maxDensity * desc.densityScale, 1e-6f);
+  return desc;
+}
+
+template shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<float>&);
+template shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<nanovdb::Fp4>&);
+template shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<nanovdb::Fp8>&);
+template shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<nanovdb::Fp16>&);
+template shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<nanovdb::FpN>&);
+
+}  // namespace peacock
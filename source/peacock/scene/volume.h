@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include <nanovdb/GridHandle.h>
+#include <nanovdb/NanoVDB.h>
+
+#include "peacock/shaderio.h"
+
+namespace peacock {
+
+// Storage format of the converted NanoVDB density grid. The quantized formats keep
+// per-leaf min/quantum headers with 4, 8 or 16 bit codes; FpN picks the bit width per
+// leaf so that the absolute error stays below a tolerance.
+enum class VolumePrecision { eFloat, eFp16, eFp8, eFp4, eFpN };
+
+// "float", "fp16", "fp8", "fp4" or "fpn"; throws std::runtime_error otherwise.
+VolumePrecision parseVolumePrecision(const std::string& name);
+const char* volumePrecisionName(VolumePrecision precision);
+nanovdb::GridType volumePrecisionGridType(VolumePrecision precision);
+
+// Reads the first float grid of an OpenVDB file and converts it to NanoVDB in the
+// requested precision. `tolerance` is the absolute error bound used by FpN.
+nanovdb::GridHandle<> loadNanoVolume(const std::filesystem::path& vdbPath,
+                                     VolumePrecision precision = VolumePrecision::eFloat,
+                                     float tolerance = 0.001f);
+
+// Shader-side description of a NanoVDB density grid: world→index transform,
+// world bounds and the default medium parameters. Instantiated for float and the
+// quantized build types.
+template <typename BuildT>
+shaderio::VolumeDesc makeVolumeDesc(const nanovdb::NanoGrid<BuildT>& grid);
+
+}  // namespace peacock
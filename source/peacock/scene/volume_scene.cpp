@@ -0,0 +1,232 @@
+#include "peacock/scene/volume_scene.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace peacock {
+
+namespace {
+
+class LineParser {
+public:
+  LineParser(const std::filesystem::path& file, uint32_t line, const std::string& text)
+      : m_file(file), m_line(line), m_stream(text) {}
+
+  bool next(std::string& word) { return static_cast<bool>(m_stream >> word); }
+
+  // Reads a number if one follows, otherwise leaves the line untouched.
+  bool tryNumber(float& value) {
+    m_stream.clear();  // tellg fails once the end of the line was reached
+    const std::streampos start = m_stream.tellg();
+    std::string word;
+    if (next(word)) {
+      try {
+        size_t used = 0;
+        value = std::stof(word, &used);
+        if (used == word.size()) {
+          return true;
+        }
+      } catch (const std::exception&) {
+      }
+    }
+    m_stream.clear();
+    m_stream.seekg(start);
+    return false;
+  }
+
+  float number() {
+    float value = 0.0f;
+    if (!tryNumber(value)) {
+      fail("expected a number");
+    }
+    return value;
+  }
+
+  glm::vec3 vec3() {
+    const float x = number();
+    const float y = number();
+    const float z = number();
+    return {x, y, z};
+  }
+
+  [[noreturn]] void fail(const std::string& message) const {
+    throw std::runtime_error(m_file.string() + ":" + std::to_string(m_line) + ": " + message);
+  }
+
+private:
+  const std::filesystem::path& m_file;
+  uint32_t m_line;
+  std::istringstream m_stream;
+};
+
+VolumeScene::Instance parseInstance(LineParser& parser, size_t volumeCount) {
+  VolumeScene::Instance instance;
+  const float volume = parser.number();
+  if (volume < 0.0f || volume != static_cast<float>(static_cast<uint32_t>(volume)) ||
+      static_cast<size_t>(volume) >= volumeCount) {
+    parser.fail("instance refers to an undeclared volume");
+  }
+  instance.volume = static_cast<uint32_t>(volume);
+
+  glm::vec3 translation{0.0f};
+  glm::mat4 rotation{1.0f};
+  glm::vec3 scale{1.0f};
+  std::string key;
+  while (parser.next(key)) {
+    if (key == "translate") {
+      translation = parser.vec3();
+    } else if (key == "rotate") {
+      const float degrees = parser.number();
+      const glm::vec3 axis = parser.vec3();
+      if (glm::dot(axis, axis) == 0.0f) {
+        parser.fail("rotation axis is zero");
+      }
+      rotation = glm::rotate(glm::mat4(1.0f), glm::radians(degrees), glm::normalize(axis)) * rotation;
+    } else if (key == "scale") {
+      // One uniform factor or three per-axis factors
+      scale = glm::vec3(parser.number());
+      if (parser.tryNumber(scale.y)) {
+        scale.z = parser.number();
+      }
+      if (scale.x <= 0.0f || scale.y <= 0.0f || scale.z <= 0.0f) {
+        parser.fail("scale must be positive");
+      }
+    } else if (key == "density") {
+      instance.density = parser.number();
+    } else if (key == "sigma_a") {
+      instance.sigma_a = parser.vec3();
+    } else if (key == "sigma_s") {
+      instance.sigma_s = parser.vec3();
+    } else if (key == "g") {
+      instance.g = glm::clamp(parser.number(), -0.99f, 0.99f);
+      instance.overrideG = true;
+    } else {
+      parser.fail("unknown instance keyword '" + key + "'");
+    }
+  }
+
+  instance.localToWorld = glm::translate(glm::mat4(1.0f), translation) * rotation *
+                          glm::scale(glm::mat4(1.0f), scale);
+  return instance;
+}
+
+shaderio::LightDesc parseLight(LineParser& parser) {
+  shaderio::LightDesc light;
+  std::string type;
+  if (!parser.next(type)) {
+    parser.fail("light needs a type");
+  }
+  if (type == "directional") {
+    light.type = shaderio::eLightDirectional;
+  } else if (type == "rectangle") {
+    light.type = shaderio::eLightRectangle;
+  } else if (type == "disk") {
+    light.type = shaderio::eLightDisk;
+  } else if (type == "triangle") {
+    light.type = shaderio::eLightTriangle;
+  } else {
+    parser.fail("unknown light type '" + type +
+                "' (expected directional, rectangle, disk or triangle)");
+  }
+
+  const bool planar = light.type == shaderio::eLightRectangle || light.type == shaderio::eLightDisk;
+  std::string key;
+  while (parser.next(key)) {
+    if (key == "radiance") {
+      light.radiance = parser.vec3();
+    } else if (key == "direction" && light.type == shaderio::eLightDirectional) {
+      light.p0 = parser.vec3();
+    } else if (key == "center" && planar) {
+      light.p0 = parser.vec3();
+    } else if (key == "u" && planar) {
+      light.p1 = parser.vec3();
+    } else if (key == "v" && planar) {
+      light.p2 = parser.vec3();
+    } else if (key == "v0" && light.type == shaderio::eLightTriangle) {
+      light.p0 = parser.vec3();
+    } else if (key == "v1" && light.type == shaderio::eLightTriangle) {
+      light.p1 = parser.vec3();
+    } else if (key == "v2" && light.type == shaderio::eLightTriangle) {
+      light.p2 = parser.vec3();
+    } else {
+      parser.fail("unknown " + type + " light keyword '" + key + "'");
+    }
+  }
+
+  if (light.type == shaderio::eLightDirectional) {
+    if (glm::dot(light.p0, light.p0) == 0.0f) {
+      parser.fail("directional light needs a direction");
+    }
+    light.p0 = glm::normalize(light.p0);
+  } else if (light.type == shaderio::eLightTriangle) {
+    if (glm::length(glm::cross(light.p1 - light.p0, light.p2 - light.p0)) == 0.0f) {
+      parser.fail("triangle light is degenerate");
+    }
+  } else {
+    const float lu = glm::length(light.p1);
+    const float lv = glm::length(light.p2);
+    if (lu == 0.0f || lv == 0.0f) {
+      parser.fail(type + " light needs u and v axes");
+    }
+    if (std::abs(glm::dot(light.p1, light.p2)) > 1e-4f * lu * lv) {
+      parser.fail(type + " light axes u and v must be perpendicular");
+    }
+  }
+  return light;
+}
+
+}  // namespace
+
+VolumeScene VolumeScene::load(const std::filesystem::path& scenePath) {
+  std::ifstream file(scenePath);
+  if (!file) {
+    throw std::runtime_error("Failed to open scene file: " + scenePath.string());
+  }
+
+  VolumeScene scene;
+  std::string text;
+  for (uint32_t line = 1; std::getline(file, text); ++line) {
+    if (const size_t comment = text.find('#'); comment != std::string::npos) {
+      text.resize(comment);
+    }
+    LineParser parser(scenePath, line, text);
+    std::string keyword;
+    if (!parser.next(keyword)) {
+      continue;
+    }
+    if (keyword == "volume") {
+      std::string path;
+      if (!parser.next(path)) {
+        parser.fail("volume needs a path");
+      }
+      std::filesystem::path volumePath(path);
+      scene.volumes.push_back(volumePath.is_absolute() ? volumePath
+                                                       : scenePath.parent_path() / volumePath);
+    } else if (keyword == "instance") {
+      scene.instances.push_back(parseInstance(parser, scene.volumes.size()));
+    } else if (keyword == "light") {
+      scene.lights.push_back(parseLight(parser));
+    } else {
+      parser.fail("unknown statement '" + keyword + "'");
+    }
+  }
+
+  if (scene.instances.empty()) {
+    throw std::runtime_error("Scene file has no instances: " + scenePath.string());
+  }
+  return scene;
+}
+
+VolumeScene VolumeScene::single(const std::filesystem::path& vdbPath) {
+  VolumeScene scene;
+  scene.volumes.push_back(vdbPath);
+  scene.instances.emplace_back();
+  return scene;
+}
+
+}  // namespace peacock
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "peacock/shaderio.h"
+
+namespace peacock {
+
+// A set of placed volumes: the distinct VDB files and the instances referencing them.
+//
+// Scene files are plain text, one statement per line, `#` starts a comment:
+//
+//   volume  clouds/cumulus.vdb          # volume 0, relative to the scene file
+//   volume  smoke.vdb                   # volume 1
+//   instance 0 translate 0 0 0
+//   instance 0 translate 120 10 -40 rotate 35 0 1 0 scale 0.5 density 2
+//   instance 1 translate 0 60 0 sigma_a 0.2 0.2 0.2 sigma_s 1 0.9 0.8 g 0.6
+//   light directional direction 0.3 1 0.2 radiance 4 3.8 3.5
+//   light rectangle center 0 80 0 u 10 0 0 v 0 0 5 radiance 20 20 20
+//   light disk center 0 80 40 u 3 0 0 v 0 3 0 radiance 50 40 30
+//   light triangle v0 0 0 0 v1 10 0 0 v2 0 10 0 radiance 10 10 10
+//
+// Transform keywords are applied in the order scale, rotate (degrees about an axis),
+// translate, whatever their order on the line. density, sigma_a and sigma_s multiply
+// the scene-wide medium parameters; g replaces the scene-wide HG asymmetry.
+//
+// Lights add to the HDR environment, which is always present. Rectangle and disk
+// axes are half extents and must be perpendicular; area lights emit on both sides
+// and do not occlude. A directional light's radiance is its irradiance.
+struct VolumeScene {
+  struct Instance {
+    uint32_t volume{0};
+    glm::mat4 localToWorld{1.0f};
+    float density{1.0f};
+    glm::vec3 sigma_a{1.0f};
+    glm::vec3 sigma_s{1.0f};
+    float g{0.0f};
+    bool overrideG{false};
+  };
+
+  std::vector<std::filesystem::path> volumes;
+  std::vector<Instance> instances;
+  std::vector<shaderio::LightDesc> lights;  // selection fields are set by LightList
+
+  // Throws std::runtime_error with the file and line of the first error.
+  static VolumeScene load(const std::filesystem::path& scenePath);
+  // One untransformed instance of a single volume, the default without --scene.
+  static VolumeScene single(const std::filesystem::path& vdbPath);
+};
+
+}  // namespace peacock
@@ -0,0 +1,87 @@
+#include "peacock/shader_reloader.h"
+
+#include <cstdio>
+#include <system_error>
+
+namespace peacock {
+
+void ShaderReloader::start(const std::filesystem::path& directory, Rebuild rebuild) {
+  stop();
+  m_directory = directory;
+  m_rebuild = std::move(rebuild);
+  m_stop = false;
+  m_requested = false;
+  m_stamps.clear();
+  scan();  // baseline: the running pipelines were built from these sources
+  m_thread = std::thread(&ShaderReloader::run, this);
+  printf("[Shaders] watching %s for changes\n", m_directory.string().c_str());
+}
+
+void ShaderReloader::stop() {
+  if (!m_thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+void ShaderReloader::requestRebuild() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requested = true;
+  }
+  m_wake.notify_all();
+}
+
+void ShaderReloader::run() {
+  bool pending = false;  // a change was seen, waiting for the files to settle
+  while (true) {
+    bool requested = false;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait_for(lock, kPollInterval, [this] { return m_stop || m_requested; });
+      if (m_stop) {
+        return;
+      }
+      requested = m_requested;
+      m_requested = false;
+    }
+
+    // Editors often write a file in several steps; rebuild one quiet poll later.
+    const bool changed = scan();
+    if (changed) {
+      pending = true;
+      continue;
+    }
+    if (!pending && !requested) {
+      continue;
+    }
+    pending = false;
+
+    const bool ok = m_rebuild();
+    m_failed = !ok;
+    if (ok) {
+      ++m_rebuilds;
+    }
+  }
+}
+
+bool ShaderReloader::scan() {
+  std::unordered_map<std::string, std::filesystem::file_time_type> stamps;
+  std::error_code error;
+  for (auto it = std::filesystem::recursive_directory_iterator(m_directory, error);
+       !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+    if (it->is_regular_file(error) && it->path().extension() == ".slang") {
+      stamps[it->path().string()] = it->last_write_time(error);
+    }
+  }
+  const bool changed = stamps != m_stamps;
+  m_stamps = std::move(stamps);
+  return changed;
+}
+
+}  // namespace peacock
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace peacock {
+
+// Watches the Slang sources under a directory and rebuilds the shaders on a worker
+// thread whenever one of them changes, so editing a shader never stalls a frame.
+//
+// The watcher polls modification times (no platform file-notification API); a burst
+// of saves is folded into one rebuild once the files have been quiet for a moment.
+// `rebuild` runs on the worker and must publish its result itself (see
+// Raytracer::rebuildShaders); it returns false when compilation failed.
+class ShaderReloader {
+public:
+  using Rebuild = std::function<bool()>;
+
+  ~ShaderReloader() { stop(); }
+
+  void start(const std::filesystem::path& directory, Rebuild rebuild);
+  void stop();
+  bool running() const { return m_thread.joinable(); }
+
+  // Rebuilds on the next poll even if nothing changed.
+  void requestRebuild();
+
+  const std::filesystem::path& directory() const { return m_directory; }
+  uint32_t rebuildCount() const { return m_rebuilds.load(); }
+  bool lastRebuildFailed() const { return m_failed.load(); }
+
+  static constexpr std::chrono::milliseconds kPollInterval{250};
+
+private:
+  void run();
+  bool scan();  // true when a source was added, removed or modified since the last scan
+
+  std::filesystem::path m_directory;
+  Rebuild m_rebuild;
+  std::unordered_map<std::string, std::filesystem::file_time_type> m_stamps;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stop{false};
+  bool m_requested{false};
+
+  std::atomic<uint32_t> m_rebuilds{0};
+  std::atomic<bool> m_failed{false};
+};
+
+}  // namespace peacock
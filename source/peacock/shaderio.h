@@ -13,6 +13,82 @@ enum BindingIndex {
   eVolumeGrid = 2,  // StructuredBuffer<uint> — raw NanoVDB bytes
   eVolumeDesc = 3,  // VolumeDesc UBO
   eHdrImage = 4,
+  eMajorantGrid = 5,  // StructuredBuffer<float> — raw max density per coarse cell
+  eEnvDistribution = 6,  // StructuredBuffer<float> — environment pdf + CDF tables
+  eAccumBuffer = 7,  // RWStructuredBuffer<float4> — fp32 mean + luminance moments, 2 per pixel
+  eConvergence = 8,  // RWStructuredBuffer<uint> — converged-pixel counters, one per slot
+  eWavefrontPaths = 9,     // RWStructuredBuffer<float4> — SoA path state, WavefrontPathField x N
+  eWavefrontQueues = 10,   // RWStructuredBuffer<uint> — path indices, WavefrontQueue x N
+  eWavefrontCounters = 11,  // RWStructuredBuffer<uint> — per-queue dispatch args + sort bins
+  eVolumeInstances = 12,   // StructuredBuffer<VolumeInstance> — placed volumes of the scene
+  eTopLevelAS = 13,        // TLAS over the instance bounds, ray-query shader module only
+  eLights = 14,            // StructuredBuffer<LightDesc> — light list with its alias table
+  eReservoirs = 15,        // RWStructuredBuffer<float4> — direct-light reservoirs, 2 x 2 per pixel
+  eHistoryBuffer = 16,     // StructuredBuffer<float4> — eAccumBuffer before the camera moved
+  eAovBuffer = 17,         // RWStructuredBuffer<float4> — albedo + transmittance AOVs, 2 per pixel
+  eDenoiseBuffer = 18,     // RWStructuredBuffer<float4> — denoiser ping-pong, 2 x N
+  eTransmittanceCache = 19,  // RWStructuredBuffer<float4> — SH transmittance grid, 3 x cells
+};
+
+// ── Sampler settings ─────────────────────────────────────────────────────────
+// Uniform numbers of the fixed path decisions (pixel jitter, light, phase, roulette);
+// tracking always uses the PCG stream, see random::PathSampler.
+enum SampleSequence {
+  eSequenceIndependent = 0,  // PCG32, plain Monte Carlo
+  eSequenceSobol = 1,        // Owen-scrambled Sobol, shuffled per pixel
+  eSequenceRank1 = 2,        // R1/R2 rank-1 lattice with a blue-noise rotation per pixel
+};
+
+// Transmittance estimator of the shadow rays, see sampler.slang.
+enum TransmittanceEstimator {
+  eTransmittanceRatio = 0,          // ratio tracking against the cell majorant
+  eTransmittanceResidualRatio = 1,  // residual ratio tracking around the cell mean
+  eTransmittanceTrackLength = 2,    // delta tracking, 0 or 1
+};
+
+// ── Wavefront integrator ─────────────────────────────────────────────────────
+// One float4 array of N (= pixel count) entries per field.
+enum WavefrontPathField {
+  eFieldOrigin = 0,      // ray origin, pixel sample index (path index == pixel index)
+  eFieldDirection = 1,   // ray direction, pdf of the phase sample that produced it
+  eFieldThroughput = 2,  // path throughput, depth
+  eFieldRadiance = 3,    // accumulated radiance, rng state
+  eFieldScatter = 4,     // scatter position, HG g
+  eFieldPrimaryDepth = 5,  // distance to the first scatter event (0 = none), yzw unused
+  eFieldCount = 6,
+};
+
+// Queues of path indices between the stages; each holds up to N entries.
+enum WavefrontQueue {
+  eQueueRay0 = 0,     // rays to trace, ping-pong with eQueueRay1 across depths
+  eQueueRay1 = 1,
+  eQueueScatter = 2,  // paths with a real scatter event, in arrival order
+  eQueueSorted = 3,   // eQueueScatter ordered by NanoVDB leaf
+  eQueueMiss = 4,     // paths that left the volume
+  eQueueCount = 5,
+};
+
+// Counters buffer: per queue {count, groupsX, 1, 1}, usable as VkDispatchIndirectCommand
+// at offset (queue * 4 + 1) * 4, followed by the counting-sort bins.
+static const uint32_t kWavefrontGroupSize = 64;
+static const uint32_t kWavefrontSortBins = 4096;
+static const uint32_t kWavefrontCounterCount = eQueueCount * 4 + kWavefrontSortBins;
+
+// Push constants of the wavefront stages, the denoiser passes and the transmittance
+// cache build; the megakernel entry points ignore them.
+struct WavefrontPushConstant {
+  unsigned int sampleIndex{0};  // wave within the dispatch, one sample per pixel each
+  unsigned int depth{0};
+  unsigned int inQueue{0};      // queue the stage consumes
+  unsigned int outQueue{0};     // queue the stage appends to
+  unsigned int resetMask{0};    // prepare stage: queues whose count is cleared
+  unsigned int filterPass{0};   // denoiser: a-trous level, taps 2^filterPass apart
+  unsigned int filterPassCount{0};  // the last pass also writes the output image
+  float luminanceSigma{4.0f};       // denoiser edge stops, see denoiseAtrous
+  float depthSigma{0.2f};
+  float transmittanceSigma{0.1f};
+  unsigned int cacheCellBegin{0};   // transmittance cache: cells built by this dispatch
+  unsigned int cacheCellEnd{0};
 };
 
 struct SceneInfo {
@@ -24,7 +100,46 @@ struct SceneInfo {
   unsigned int frameIndex{0};        // Current frame index (for RNG seed)
   int maxScatterDepth{3};            // Maximum number of scattering events per path
   int russianRouletteDepth{3};        // Depth to start Russian Roulette path termination
-  int pad{0};
+  // Adaptive sampling: a pixel stops taking samples once the relative standard error
+  // of its luminance mean drops below noiseThreshold (0 = off) after adaptiveMinSamples.
+  float noiseThreshold{0.0f};
+  unsigned int adaptiveMinSamples{16};
+  unsigned int convergenceSlot{0};   // counter the converged pixels are added to
+  unsigned int countConverged{0};    // set on the last dispatch of a frame only
+  unsigned int instanceCount{1};     // entries of the eVolumeInstances buffer
+  unsigned int sampleSequence{eSequenceSobol};  // SampleSequence
+  unsigned int transmittanceEstimator{eTransmittanceResidualRatio};  // TransmittanceEstimator
+  // Coarse density levels: paths from scatter depth lodDepth on (and shadow rays from
+  // lodShadowDepth on) sample one level coarser per further bounce; 0 = full resolution.
+  unsigned int lodDepth{0};
+  unsigned int lodShadowDepth{0};
+  unsigned int lightCount{1};        // entries of the eLights buffer, the environment first
+  // Resampled direct lighting: light candidates per scatter event (0 = one NEE sample
+  // with MIS) and the kRestir* reuse of the primary-scatter reservoirs.
+  unsigned int risCandidates{0};
+  unsigned int risReuse{0};
+  // Temporal reprojection: set on the first frame after a camera move (the first visit
+  // of every band when tiled), which merges the eHistoryBuffer image seen from
+  // prevViewProjMatrix instead of starting empty.
+  unsigned int reprojectHistory{0};
+  glm::mat4 prevViewProjMatrix{1.0f};
+  glm::vec3 prevCameraPosition{0.0f};
+  unsigned int motionFrames{0};      // frames rendered while moving, offsets the sequences
+  unsigned int aovs{0};              // accumulate the denoiser's AOVs
+  // Tiled frames: the image is split into tileCount bands of rows and a frame traces
+  // band tileIndex only, which has been traced tileVisit times since the last restart.
+  unsigned int tileCount{1};
+  unsigned int tileIndex{0};
+  unsigned int tileVisit{0};
+  unsigned int previewLight{0};      // light-list entry lighting the ray-marched preview
+  // Transmittance cache: shadow rays from scatter depth transmittanceCacheDepth on
+  // (0 = off) read the eTransmittanceCache grid of transmittanceCacheRes^3 cells over
+  // [transmittanceCacheMin, transmittanceCacheMax] instead of tracking.
+  unsigned int transmittanceCacheDepth{0};
+  unsigned int transmittanceCacheRes{2};
+  unsigned int _pad0{0};
+  glm::vec3 transmittanceCacheMin{0.0f};  float _pad1{0.0f};
+  glm::vec3 transmittanceCacheMax{0.0f};  float _pad2{0.0f};
 };
 
 struct VolumeDesc {
@@ -33,21 +148,87 @@ struct VolumeDesc {
 
   // ── Bounding box (world space) ────────────────────────────────────────────
   glm::vec3 bboxMin{0.0f};  float _pad0{0.0f};
-  glm::vec3 bboxMax{0.0f};  float stepSize{0.5f};  // ray-march step hint
+  glm::vec3 bboxMax{0.0f};  float stepSize{0.5f};  // preview ray-march step, in voxels
 
   // ── Medium optical properties (scale factors applied to density) ──────────
   glm::vec3 sigma_a{0.0f};       float majorant{1.0f};       // absorption scale + global extinction bound
   glm::vec3 sigma_s{1.0f};       float densityScale{1.0f};   // scattering scale + raw→extinction factor
   glm::vec3 Le{0.0f};            float g{0.0f};              // emission scale + HG asymmetry
+
+  // ── Majorant grid (index space, see scene/majorant_grid.h) ────────────────
+  glm::vec3 majorantGridMin{0.0f};  float majorantCellSize{16.0f};  // origin + cell edge in voxels
+  glm::uvec3 majorantGridRes{0u};   unsigned int _pad1{0};          // cells per axis
+};
+
+// ── Volume instances ─────────────────────────────────────────────────────────
+// One placed copy of a density grid; several instances may share a grid. The grids
+// and majorant grids of every volume of the scene are packed into the eVolumeGrid and
+// eMajorantGrid buffers and addressed through the offsets below. The medium factors
+// multiply the scene-wide parameters of VolumeDesc, so the UI still drives them all.
+static const uint32_t kVolumeInstanceOverrideG = 1u;  // use VolumeInstance::g, not VolumeDesc::g
+static const uint32_t kMaxDensityLods = 3u;  // coarse levels of a DensityPyramid, 2x/4x/8x voxels
+
+struct VolumeInstance {
+  glm::mat4 worldToLocal{1.0f};  // scene → the grid's own world space
+  glm::mat4 localToIndex{1.0f};  // grid world → index space (VolumeDesc::worldToIndex of the grid)
+
+  glm::vec3 bboxMin{0.0f};  unsigned int gridOffset{0};      // grid-world bounds + byte offset of the grid
+  glm::vec3 bboxMax{0.0f};  unsigned int majorantOffset{0};  // + first cell of its majorant grid
+
+  glm::vec3 majorantGridMin{0.0f};  float majorantCellSize{16.0f};
+  glm::uvec3 majorantGridRes{0u};   float densityScale{1.0f};  // x VolumeDesc::densityScale
+
+  glm::vec3 sigma_a{1.0f};  float g{0.0f};           // x VolumeDesc::sigma_a + HG asymmetry
+  glm::vec3 sigma_s{1.0f};  unsigned int flags{0};   // x VolumeDesc::sigma_s + kVolumeInstance*
+
+  // Byte offsets of the coarse density levels in eVolumeGrid, and how many exist.
+  // Level l reads the majorant grid at majorantOffset + l * 2 * cell count.
+  glm::uvec3 lodGridOffset{0u};  unsigned int lodLevels{0};
+};
+
+// SceneInfo::risReuse flags: reservoirs of the previous frame at the same pixel
+// (temporal) and at random neighbours (spatial).
+static const uint32_t kRestirTemporal = 1u;
+static const uint32_t kRestirSpatial = 2u;
+
+// ── Lights ───────────────────────────────────────────────────────────────────
+// Every scatter event samples one light of the list with NEE, picked in proportion to
+// its estimated power through a Walker alias table stored alongside (see
+// scene/light_list.h). Entry 0 is always the environment.
+enum LightType {
+  eLightEnvironment = 0,  // the HDR environment; p0-p2 unused
+  eLightDirectional = 1,  // p0: direction towards the light; radiance is the irradiance
+  eLightRectangle = 2,    // p0: center, p1/p2: perpendicular half-extent axes
+  eLightDisk = 3,         // p0: center, p1/p2: perpendicular radius axes
+  eLightTriangle = 4,     // p0-p2: vertices
+};
+
+struct LightDesc {
+  glm::vec3 radiance{1.0f};  unsigned int type{eLightEnvironment};
+  glm::vec3 p0{0.0f};        float pmf{1.0f};        // selection probability of this light
+  glm::vec3 p1{0.0f};        float aliasProb{1.0f};  // alias table: keep this entry below it
+  glm::vec3 p2{0.0f};        unsigned int alias{0};  // otherwise take this one
 };
 
 static_assert(std::is_standard_layout_v<SceneInfo>);
+static_assert(offsetof(SceneInfo, prevViewProjMatrix) == 272);
+static_assert(sizeof(SceneInfo) == 416);
 static_assert(std::is_standard_layout_v<VolumeDesc>);
 static_assert(offsetof(VolumeDesc, bboxMin)  == 64);
 static_assert(offsetof(VolumeDesc, bboxMax)  == 80);
 static_assert(offsetof(VolumeDesc, sigma_a)  == 96);
 static_assert(offsetof(VolumeDesc, sigma_s)  == 112);
 static_assert(offsetof(VolumeDesc, Le)       == 128);
-static_assert(sizeof(VolumeDesc) == 144);
+static_assert(offsetof(VolumeDesc, majorantGridMin) == 144);
+static_assert(offsetof(VolumeDesc, majorantGridRes) == 160);
+static_assert(sizeof(VolumeDesc) == 176);
+static_assert(std::is_standard_layout_v<VolumeInstance>);
+static_assert(offsetof(VolumeInstance, bboxMin)         == 128);
+static_assert(offsetof(VolumeInstance, majorantGridMin) == 160);
+static_assert(offsetof(VolumeInstance, sigma_a)         == 192);
+static_assert(offsetof(VolumeInstance, lodGridOffset)   == 224);
+static_assert(sizeof(VolumeInstance) == 240);
+static_assert(std::is_standard_layout_v<LightDesc>);
+static_assert(sizeof(LightDesc) == 64);
 
 NAMESPACE_SHADERIO_END()
\ No newline at end of file
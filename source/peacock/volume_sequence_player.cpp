@@ -0,0 +1,389 @@
+#include "peacock/volume_sequence_player.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <span>
+#include <string>
+
+#include <nvvk/check_error.hpp>
+#include <nvvk/debug_util.hpp>
+
+#include "peacock/scene/host_volume.h"
+#include "peacock/scene/majorant_grid.h"
+#include "peacock/scene/volume.h"
+
+namespace peacock {
+
+namespace {
+
+// Splits "smoke.0012.vdb" into prefix "smoke.", digits "0012" and extension ".vdb".
+bool splitFrameName(const std::filesystem::path& path, std::string& prefix, std::string& digits) {
+  const std::string stem = path.stem().string();
+  size_t end = stem.size();
+  size_t begin = end;
+  while (begin > 0 && std::isdigit(static_cast<unsigned char>(stem[begin - 1]))) {
+    --begin;
+  }
+  if (begin == end) {
+    return false;
+  }
+  prefix = stem.substr(0, begin);
+  digits = stem.substr(begin, end - begin);
+  return true;
+}
+
+} // namespace
+
+std::vector<std::filesystem::path> VolumeSequencePlayer::findSequence(
+    const std::filesystem::path& firstFrame) {
+  std::string prefix, digits;
+  if (!splitFrameName(firstFrame, prefix, digits)) {
+    return {firstFrame};
+  }
+
+  const std::filesystem::path dir =
+      firstFrame.has_parent_path() ? firstFrame.parent_path() : std::filesystem::path(".");
+  const std::string extension = firstFrame.extension().string();
+  const unsigned long firstNumber = std::stoul(digits);
+
+  std::vector<std::pair<unsigned long, std::filesystem::path>> numbered;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    std::string entryPrefix, entryDigits;
+    if (!entry.is_regular_file() || entry.path().extension().string() != extension ||
+        !splitFrameName(entry.path(), entryPrefix, entryDigits) || entryPrefix != prefix) {
+      continue;
+    }
+    const unsigned long number = std::stoul(entryDigits);
+    if (number >= firstNumber) {
+      numbered.emplace_back(number, entry.path());
+    }
+  }
+  std::sort(numbered.begin(), numbered.end());
+
+  std::vector<std::filesystem::path> frames;
+  frames.reserve(numbered.size());
+  for (auto& [number, path] : numbered) {
+    frames.push_back(std::move(path));
+  }
+  if (frames.empty()) {
+    frames.push_back(firstFrame);
+  }
+  return frames;
+}
+
+void VolumeSequencePlayer::init(nvapp::Application* app, nvvk::ResourceAllocator* allocator,
+                                std::vector<std::filesystem::path> frames,
+                                const RaytracerSettings& settings) {
+  m_app = app;
+  m_allocator = allocator;
+  m_frames = std::move(frames);
+  m_loadOptions = VolumeLoadOptions::fromSettings(settings);
+  m_majorantCellSize = settings.majorantCellSize;
+  fps = settings.sequenceFps;
+  if (empty()) {
+    return;
+  }
+
+  const VkDevice device = m_app->getDevice();
+  m_graphicsFamily = m_app->getQueue(0).familyIndex;
+  m_transferFamily = m_app->getQueue(1).familyIndex;
+  m_transferQueue = m_app->getQueue(1).queue;
+
+  VkSemaphoreTypeCreateInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  const VkSemaphoreCreateInfo semaphoreInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &timelineInfo,
+  };
+  NVVK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_timeline));
+  NVVK_DBG_NAME(m_timeline);
+
+  for (Slot& slot : m_slots) {
+    const VkCommandPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = m_transferFamily,
+    };
+    NVVK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &slot.cmdPool));
+    const VkCommandBufferAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = slot.cmdPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    NVVK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &slot.cmd));
+  }
+
+  const uint32_t threadCount = std::max(settings.sequenceThreads, 1u);
+  for (uint32_t i = 0; i < threadCount; ++i) {
+    m_workers.emplace_back(&VolumeSequencePlayer::workerLoop, this);
+  }
+  m_lastSwap = std::chrono::steady_clock::now();
+
+  printf("[Sequence] %u frames starting at %s, %u loader threads\n", frameCount(),
+         m_frames.front().filename().string().c_str(), threadCount);
+}
+
+void VolumeSequencePlayer::deinit() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopping = true;
+    m_jobs.clear();
+  }
+  m_jobAvailable.notify_all();
+  for (std::thread& worker : m_workers) {
+    worker.join();
+  }
+  m_workers.clear();
+
+  if (m_timeline == VK_NULL_HANDLE) {
+    return;
+  }
+  const VkDevice device = m_app->getDevice();
+  NVVK_CHECK(vkQueueWaitIdle(m_transferQueue));
+  for (Slot& slot : m_slots) {
+    m_allocator->destroyBuffer(slot.grid);
+    m_allocator->destroyBuffer(slot.majorants);
+    m_allocator->destroyBuffer(slot.staging);
+    vkDestroyCommandPool(device, slot.cmdPool, nullptr);
+    slot = {};
+  }
+  vkDestroySemaphore(device, m_timeline, nullptr);
+  m_timeline = VK_NULL_HANDLE;
+  m_current = nullptr;
+}
+
+const VolumeSequencePlayer::Slot* VolumeSequencePlayer::update() {
+  if (empty()) {
+    return nullptr;
+  }
+  submitRecorded();
+  scheduleLoads();
+
+  const auto now = std::chrono::steady_clock::now();
+  if (!playing ||
+      now - m_lastSwap < std::chrono::duration<double>(1.0 / std::max(fps, 0.1f))) {
+    return nullptr;
+  }
+
+  Slot* next = nullptr;
+  {
+    std::lock_guard lock(m_mutex);
+    for (Slot& slot : m_slots) {
+      if (slot.frame != m_nextToShow) {
+        continue;
+      }
+      if (slot.state == SlotState::eFailed) {
+        // Skip unreadable frames instead of stopping playback.
+        slot.state = SlotState::eFree;
+        m_nextToShow = (m_nextToShow + 1) % frameCount();
+        return nullptr;
+      }
+      if (slot.state == SlotState::eReady) {
+        next = &slot;
+      }
+    }
+    if (next == nullptr) {
+      return nullptr;  // not resident yet: keep showing the current frame
+    }
+    next->state = SlotState::eCurrent;
+    if (m_current != nullptr) {
+      m_current->state = SlotState::eRetiring;
+    }
+  }
+
+  // The graphics submit of this frame must not read the grid before the copy landed.
+  m_app->addWaitSemaphore({
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .semaphore = m_timeline,
+      .value = next->timelineValue,
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+  });
+
+  // Frames already in flight may still read the previous slot; hand it back once they retire.
+  if (Slot* retired = m_current) {
+    m_app->submitResourceFree([this, retired]() {
+      std::lock_guard lock(m_mutex);
+      retired->state = SlotState::eFree;
+    });
+  }
+
+  m_current = next;
+  m_lastSwap = now;
+  m_nextToShow = (m_nextToShow + 1) % frameCount();
+  return next;
+}
+
+void VolumeSequencePlayer::scheduleLoads() {
+  std::lock_guard lock(m_mutex);
+  for (Slot& slot : m_slots) {
+    if (slot.state != SlotState::eFree) {
+      continue;
+    }
+    // Short sequences wrap around onto frames that are still resident; wait for them
+    // to retire rather than loading a frame twice.
+    const uint32_t frame = m_nextToSchedule;
+    const bool resident =
+        (m_current == nullptr && frame == 0) ||
+        std::any_of(m_slots.begin(), m_slots.end(), [frame](const Slot& other) {
+          return other.frame == frame && other.state != SlotState::eFree &&
+                 other.state != SlotState::eRetiring;
+        });
+    if (resident) {
+      break;
+    }
+    slot.state = SlotState::eLoading;
+    slot.frame = frame;
+    m_jobs.push_back(&slot);
+    m_jobAvailable.notify_one();
+    m_nextToSchedule = (frame + 1) % frameCount();
+  }
+}
+
+void VolumeSequencePlayer::submitRecorded() {
+  std::vector<Slot*> recorded;
+  {
+    std::lock_guard lock(m_mutex);
+    for (Slot& slot : m_slots) {
+      if (slot.state == SlotState::eRecorded) {
+        recorded.push_back(&slot);
+      }
+    }
+  }
+  // Submitting from the main thread keeps all queue access single-threaded.
+  for (Slot* slot : recorded) {
+    const uint64_t value = ++m_timelineCounter;
+    const VkCommandBufferSubmitInfo cmdInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer = slot->cmd,
+    };
+    const VkSemaphoreSubmitInfo signalInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = m_timeline,
+        .value = value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+    const VkSubmitInfo2 submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &cmdInfo,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signalInfo,
+    };
+    NVVK_CHECK(vkQueueSubmit2(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    std::lock_guard lock(m_mutex);
+    slot->timelineValue = value;
+    slot->state = SlotState::eReady;
+  }
+}
+
+void VolumeSequencePlayer::workerLoop() {
+  while (true) {
+    Slot* slot = nullptr;
+    {
+      std::unique_lock lock(m_mutex);
+      m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+      if (m_stopping) {
+        return;
+      }
+      slot = m_jobs.front();
+      m_jobs.pop_front();
+    }
+
+    SlotState result = SlotState::eRecorded;
+    try {
+      loadSlot(*slot);
+    } catch (const std::exception& e) {
+      printf("[Sequence] frame %u failed: %s\n", slot->frame, e.what());
+      result = SlotState::eFailed;
+    }
+
+    std::lock_guard lock(m_mutex);
+    slot->state = result;
+  }
+}
+
+void VolumeSequencePlayer::ensureCapacity(nvvk::Buffer& buffer, VkDeviceSize size,
+                                          VkBufferUsageFlags2KHR usage, bool hostVisible) {
+  if (buffer.buffer != VK_NULL_HANDLE && buffer.bufferSize >= size) {
+    return;  // reuse: the slot is not referenced by any pending GPU work
+  }
+  m_allocator->destroyBuffer(buffer);
+
+  // Headroom so slowly growing simulations do not re-allocate every frame.
+  const VkDeviceSize capacity = size + size / 4;
+  if (hostVisible) {
+    NVVK_CHECK(m_allocator->createBuffer(buffer, capacity, usage,
+                                         VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                         VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                             VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT));
+  } else {
+    // Written on the transfer queue, read on the graphics queue.
+    const uint32_t families[] = {m_graphicsFamily, m_transferFamily};
+    const std::span<const uint32_t> sharedFamilies =
+        m_graphicsFamily != m_transferFamily ? std::span<const uint32_t>(families)
+                                             : std::span<const uint32_t>();
+    NVVK_CHECK(m_allocator->createBuffer(buffer, capacity, usage, VMA_MEMORY_USAGE_AUTO, {}, 0,
+                                         sharedFamilies));
+  }
+  NVVK_DBG_NAME(buffer.buffer);
+}
+
+void VolumeSequencePlayer::loadSlot(Slot& slot) {
+  const VkDevice device = m_app->getDevice();
+
+  // The slot's last upload was displayed before the slot was freed, so this never
+  // blocks in practice; it makes resetting the command pool unconditionally legal.
+  if (slot.timelineValue > 0) {
+    const VkSemaphoreWaitInfo waitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_timeline,
+        .pValues = &slot.timelineValue,
+    };
+    NVVK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+  }
+
+  const HostVolume volume = HostVolume::load(m_frames[slot.frame], m_loadOptions);
+  const MajorantGrid majorants = volume.visit([&](const auto& grid) {
+    slot.desc = makeVolumeDesc(grid);
+    slot.maxDensity = static_cast<float>(grid.tree().root().maximum());
+    return MajorantGrid::build(grid, m_majorantCellSize);
+  });
+  majorants.describe(slot.desc);
+  slot.gridBytes = volume.size();
+  slot.majorantBytes = majorants.byteSize();
+
+  ensureCapacity(slot.grid, slot.gridBytes,
+                 VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_2_TRANSFER_DST_BIT, false);
+  ensureCapacity(slot.majorants, slot.majorantBytes,
+                 VK_BUFFER_USAGE_2_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_2_TRANSFER_DST_BIT, false);
+  ensureCapacity(slot.staging, slot.gridBytes + slot.majorantBytes,
+                 VK_BUFFER_USAGE_2_TRANSFER_SRC_BIT, true);
+
+  // A cache-mapped grid is paged in straight into the staging memory.
+  std::memcpy(slot.staging.mapping, volume.data(), slot.gridBytes);
+  majorants.pack(reinterpret_cast<float*>(slot.staging.mapping + slot.gridBytes));
+
+  NVVK_CHECK(vkResetCommandPool(device, slot.cmdPool, 0));
+  const VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  NVVK_CHECK(vkBeginCommandBuffer(slot.cmd, &beginInfo));
+  const VkBufferCopy gridCopy{.srcOffset = 0, .dstOffset = 0, .size = slot.gridBytes};
+  vkCmdCopyBuffer(slot.cmd, slot.staging.buffer, slot.grid.buffer, 1, &gridCopy);
+  const VkBufferCopy majorantCopy{
+      .srcOffset = slot.gridBytes, .dstOffset = 0, .size = slot.majorantBytes};
+  vkCmdCopyBuffer(slot.cmd, slot.staging.buffer, slot.majorants.buffer, 1, &majorantCopy);
+  NVVK_CHECK(vkEndCommandBuffer(slot.cmd));
+}
+
+}  // namespace peacock
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nvapp/application.hpp>
+#include <nvvk/resource_allocator.hpp>
+
+#include "peacock/render_settings.h"
+#include "peacock/scene/host_volume.h"
+#include "peacock/shaderio.h"
+
+namespace peacock {
+
+// Plays back a numbered VDB sequence (smoke.0001.vdb, smoke.0002.vdb, ...) without
+// ever blocking the render loop.
+//
+// Frames move through a small ring of GPU slots:
+//   Free -> Loading    a worker thread loads the grid (sidecar cache or OpenVDB),
+//                      builds its majorant grid, fills the slot's staging buffer and
+//                      records the copies into the slot's transfer command buffer
+//        -> Recorded   update() submits it on the transfer queue, signalling the
+//                      player's timeline semaphore
+//        -> Ready      update() swaps it in once playback reaches its frame; the next
+//                      graphics submit waits on the timeline value
+//        -> Current    bound by the ray tracer
+//        -> Retiring   released through submitResourceFree once no frame in flight
+//                      can still read it, then Free again
+// Device buffers are kept per slot and only re-created when a frame does not fit.
+class VolumeSequencePlayer {
+public:
+  enum class SlotState { eFree, eLoading, eRecorded, eReady, eCurrent, eRetiring, eFailed };
+
+  struct Slot {
+    SlotState state{SlotState::eFree};
+    uint32_t frame{0};
+
+    nvvk::Buffer grid;       // NanoVDB bytes (StructuredBuffer<uint>)
+    nvvk::Buffer majorants;  // MajorantGrid::pack layout
+    nvvk::Buffer staging;    // host-visible, grid followed by majorants
+    VkDeviceSize gridBytes{0};
+    VkDeviceSize majorantBytes{0};
+
+    VkCommandPool cmdPool{VK_NULL_HANDLE};
+    VkCommandBuffer cmd{VK_NULL_HANDLE};
+    uint64_t timelineValue{0};
+
+    // Per-frame geometry: worldToIndex, bounds and majorant-grid addressing
+    shaderio::VolumeDesc desc{};
+    float maxDensity{1.0f};
+  };
+
+  // Numbered siblings of `firstFrame` (same prefix and extension, any digit count),
+  // sorted by frame number. Returns just `firstFrame` if it is not part of a sequence.
+  static std::vector<std::filesystem::path> findSequence(const std::filesystem::path& firstFrame);
+
+  void init(nvapp::Application* app, nvvk::ResourceAllocator* allocator,
+            std::vector<std::filesystem::path> frames, const RaytracerSettings& settings);
+  void deinit();
+
+  // Called once per rendered frame on the main thread, before the frame is submitted.
+  // Submits finished uploads, schedules prefetches into free slots and swaps in the
+  // next frame when it is due and resident. Returns the newly current slot, if any.
+  const Slot* update();
+
+  const Slot* current() const { return m_current; }
+  uint32_t frameCount() const { return static_cast<uint32_t>(m_frames.size()); }
+  bool empty() const { return m_frames.size() < 2; }
+
+  bool playing{true};
+  float fps{24.0f};
+
+private:
+  static constexpr size_t kSlotCount = 3;
+
+  void workerLoop();
+  void loadSlot(Slot& slot);
+  void ensureCapacity(nvvk::Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags2KHR usage,
+                      bool hostVisible);
+  void scheduleLoads();
+  void submitRecorded();
+
+  nvapp::Application* m_app{};
+  nvvk::ResourceAllocator* m_allocator{};
+  std::vector<std::filesystem::path> m_frames;
+  VolumeLoadOptions m_loadOptions;
+  uint32_t m_majorantCellSize{16};
+
+  uint32_t m_graphicsFamily{0};
+  uint32_t m_transferFamily{0};
+  VkQueue m_transferQueue{VK_NULL_HANDLE};
+  VkSemaphore m_timeline{VK_NULL_HANDLE};
+  uint64_t m_timelineCounter{0};
+
+  std::array<Slot, kSlotCount> m_slots{};
+  Slot* m_current{nullptr};
+  uint32_t m_nextToSchedule{1};  // frame 0 is loaded synchronously by the ray tracer
+  uint32_t m_nextToShow{1};
+  std::chrono::steady_clock::time_point m_lastSwap{};
+
+  // Guards slot states and the job queue shared with the workers
+  std::mutex m_mutex;
+  std::condition_variable m_jobAvailable;
+  std::deque<Slot*> m_jobs;
+  std::vector<std::thread> m_workers;
+  bool m_stopping{false};
+};
+
+}  // namespace peacock